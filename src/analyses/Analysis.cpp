@@ -0,0 +1,166 @@
+#include "Analysis.h"
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/MultiplexConsumer.h"
+
+#include "parallel/ParallelMatch.h"
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace clang::tooling;
+using namespace llvm;
+
+LLVM_INSTANTIATE_REGISTRY(AnalysisRegistry)
+
+std::unique_ptr<Analysis> createAnalysis(StringRef Name) {
+    for (const auto &entry : AnalysisRegistry::entries()) {
+        if (entry.getName() == Name) {
+            return entry.instantiate();
+        }
+    }
+    return nullptr;
+}
+
+std::string getRecordKey(StringRef QualifiedName, StringRef File) {
+    if (!QualifiedName.contains('(')) { return QualifiedName; }
+    return (QualifiedName + StringRef("", 1) + File).str();
+}
+
+void mergeNamedRecords(StringRef Printed, StringRef Tag, unsigned FileField, StringSet<> &Seen,
+                       std::string &Output) {
+    auto keep = false;
+    while (!Printed.empty()) {
+        StringRef line;
+        std::tie(line, Printed) = Printed.split('\n');
+
+        StringRef fields = line;
+        if (fields.consume_front(Tag) && fields.consume_front("\t")) {
+            SmallVector<StringRef, 4> values;
+            fields.split(values, '\t');
+            auto file = FileField < values.size() ? values[FileField] : StringRef();
+            keep = Seen.insert(getRecordKey(values.front(), file)).second;
+        }
+        if (keep) {
+            Output += line;
+            Output += '\n';
+        }
+    }
+}
+
+namespace {
+
+// State shared by every translation unit of a run.
+struct AnalysisRun {
+    ArrayRef<std::unique_ptr<Analysis>> Analyses;
+    MatcherList Matchers;
+    MatchFinder Finder;
+    TraversalScope Scope;
+    unsigned MatchJobs;
+    StringSet<> SeenInstantiations;
+
+    void addMatchers() {
+        for (const auto &analysis : Analyses) {
+            analysis->addMatchers(Matchers);
+        }
+        Matchers.addTo(Finder);
+    }
+
+    bool needsSerialMatching() const {
+        return llvm::any_of(Analyses, [](const std::unique_ptr<Analysis> &Current) {
+            return Current->needsSerialMatching();
+        });
+    }
+
+    std::unique_ptr<ASTConsumer> createMatchConsumer() {
+        if (MatchJobs > 1 && !needsSerialMatching() && canMatchInParallel(Matchers, Scope)) {
+            return newParallelMatchConsumer(Matchers, Scope, MatchJobs);
+        }
+        if (!Scope.empty()) {
+            return newScopedMatchConsumer(Finder, Matchers, Scope, SeenInstantiations);
+        }
+        return Finder.newASTConsumer();
+    }
+};
+
+class AnalysisAction : public ASTFrontendAction {
+    AnalysisRun &Run;
+
+public:
+    explicit AnalysisAction(AnalysisRun &Run) : Run(Run) {}
+
+    std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
+                                                   StringRef InFile) override {
+        std::vector<std::unique_ptr<ASTConsumer>> consumers;
+        consumers.push_back(Run.createMatchConsumer());
+
+        for (const auto &analysis : Run.Analyses) {
+            if (auto consumer = analysis->createASTConsumer(CI)) {
+                consumers.push_back(std::move(consumer));
+            }
+        }
+
+        if (consumers.size() == 1) { return std::move(consumers.front()); }
+
+        return llvm::make_unique<MultiplexConsumer>(std::move(consumers));
+    }
+};
+
+class AnalysisActionFactory : public FrontendActionFactory {
+    AnalysisRun Run;
+
+public:
+    AnalysisActionFactory(ArrayRef<std::unique_ptr<Analysis>> Analyses,
+                          const TraversalScope &Scope, unsigned MatchJobs) {
+        Run.Analyses = Analyses;
+        Run.Scope = Scope;
+        Run.MatchJobs = MatchJobs;
+        Run.addMatchers();
+    }
+
+    FrontendAction *create() override {
+        return new AnalysisAction(Run);
+    }
+};
+
+}
+
+std::unique_ptr<FrontendActionFactory>
+newAnalysisActionFactory(ArrayRef<std::unique_ptr<Analysis>> Analyses,
+                         const TraversalScope &Scope, unsigned MatchJobs) {
+    return llvm::make_unique<AnalysisActionFactory>(Analyses, Scope, MatchJobs);
+}
+
+MatcherList::NodeKinds getMatchedNodeKinds(ArrayRef<std::unique_ptr<Analysis>> Analyses) {
+    MatcherList matchers;
+    for (const auto &analysis : Analyses) {
+        analysis->addMatchers(matchers);
+    }
+    return matchers.getNodeKinds();
+}
+
+bool runAnalysesOnAST(ArrayRef<std::unique_ptr<Analysis>> Analyses, ASTUnit &Unit,
+                      const TraversalScope &Scope, unsigned MatchJobs) {
+    // A compiler instance over the unit's parts, only for asking each
+    // analysis for its consumer.
+    CompilerInstance instance;
+    instance.setDiagnostics(&Unit.getDiagnostics());
+    instance.setFileManager(&Unit.getFileManager());
+    instance.setSourceManager(&Unit.getSourceManager());
+    instance.setPreprocessor(Unit.getPreprocessorPtr());
+    instance.setASTContext(&Unit.getASTContext());
+    for (const auto &analysis : Analyses) {
+        if (analysis->createASTConsumer(instance)) { return false; }
+    }
+
+    auto &Context = Unit.getASTContext();
+    AnalysisRun run;
+    run.Analyses = Analyses;
+    run.Scope = Scope;
+    run.MatchJobs = MatchJobs;
+    run.addMatchers();
+    if (run.Matchers.getNodeKinds().Stmts) { return false; }
+    run.createMatchConsumer()->HandleTranslationUnit(Context);
+    return true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Registry.h"
+
+#include "matchers/MatcherList.h"
+#include "scope/TraversalScope.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+class ASTUnit;
+class CompilerInstance;
+}
+
+// One question asked of the AST. Every selected analysis runs in the same
+// parse: matchers share a single MatchFinder and consumers are multiplexed
+// with it, so adding an analysis costs a traversal, not a parse.
+//
+// An instance lives for a whole run and sees every translation unit.
+class Analysis {
+public:
+    virtual ~Analysis() = default;
+
+    // Registers matchers to run in the traversal shared by all analyses.
+    virtual void addMatchers(MatcherList &Matchers) {}
+
+    // A consumer for one translation unit, or null for matcher-only analyses.
+    virtual std::unique_ptr<clang::ASTConsumer> createASTConsumer(clang::CompilerInstance &CI) {
+        return nullptr;
+    }
+
+    // True if createASTConsumer is needed, such analyses cannot run over an
+    // AST that is already built. Lets options be checked before parsing;
+    // runAnalysesOnAST checks the consumers themselves.
+    virtual bool usesASTConsumer() const { return false; }
+
+    // True if the analysis inspects source locations or makes the ASTContext
+    // compute sizes or layouts, which races when a unit is matched on
+    // several threads. Such runs match serially whatever --tu-jobs says.
+    virtual bool needsSerialMatching() const { return false; }
+
+    // Writes what the run found, one tab separated record per line.
+    virtual void print(llvm::raw_ostream &OS) const = 0;
+
+    // Adds what another instance printed as if this one had found it, so
+    // that outputs kept per translation unit combine into exactly what one
+    // instance seeing every unit in the same order would print.
+    virtual void merge(llvm::StringRef Printed) = 0;
+};
+
+// Identifies a named record across translation units: its qualified name,
+// and also its file when the name is in an anonymous namespace, which every
+// file has its own of.
+std::string getRecordKey(llvm::StringRef QualifiedName, llvm::StringRef File);
+
+// For analyses that report each record once: appends the records in
+// Printed, each a line starting with Tag and the name, with the file in
+// field FileField after the tag, followed by lines of its own, whose
+// getRecordKey is not yet in Seen.
+void mergeNamedRecords(llvm::StringRef Printed, llvm::StringRef Tag, unsigned FileField,
+                       llvm::StringSet<> &Seen, std::string &Output);
+
+// Analyses register themselves by name:
+//   static AnalysisRegistry::Add<MyAnalysis> X("my-analysis", "description");
+typedef llvm::Registry<Analysis> AnalysisRegistry;
+
+// Null if no analysis is registered under Name.
+std::unique_ptr<Analysis> createAnalysis(llvm::StringRef Name);
+
+// Builds actions whose consumer runs every analysis' matchers and consumer
+// over the same AST. Matchers only traverse the part of the AST inside
+// Scope, split across MatchJobs threads when more than one.
+std::unique_ptr<clang::tooling::FrontendActionFactory>
+newAnalysisActionFactory(llvm::ArrayRef<std::unique_ptr<Analysis>> Analyses,
+                         const TraversalScope &Scope, unsigned MatchJobs);
+
+// The kinds of node the analyses' matchers match.
+MatcherList::NodeKinds getMatchedNodeKinds(llvm::ArrayRef<std::unique_ptr<Analysis>> Analyses);
+
+// Runs the analyses' matchers over the AST of Unit, a merged AST that is
+// already built. Returns false without running anything if an analysis
+// creates an AST consumer, which would never see the declarations, or
+// matches statements, which the merged AST does not hold completely.
+bool runAnalysesOnAST(llvm::ArrayRef<std::unique_ptr<Analysis>> Analyses, clang::ASTUnit &Unit,
+                      const TraversalScope &Scope, unsigned MatchJobs);
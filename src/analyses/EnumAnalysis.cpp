@@ -0,0 +1,74 @@
+#include "Analysis.h"
+
+#include "clang/AST/Decl.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "llvm/ADT/StringSet.h"
+
+using namespace clang;
+using namespace llvm;
+
+namespace {
+
+// Enumerations and their values, printed as
+//   enum        <qualified name>  <file>
+//   enumerator  <name>  <value>
+//
+// Enums come from Sema rather than a traversal, so the traversal scope does
+// not apply and the analysis is rejected when one is set.
+class EnumAnalysis : public Analysis {
+    std::string Output;
+    StringSet<> Seen;
+
+    // Sema hands over every tag definition as it is parsed, so enums need
+    // no traversal of their own.
+    class Consumer : public ASTConsumer {
+        EnumAnalysis &Parent;
+        SourceManager &Sources;
+
+    public:
+        Consumer(EnumAnalysis &Parent, SourceManager &Sources)
+            : Parent(Parent), Sources(Sources) {}
+
+        void HandleTagDeclDefinition(TagDecl *D) override {
+            if (const auto *decl = dyn_cast<EnumDecl>(D)) {
+                Parent.add(*decl, Sources);
+            }
+        }
+    };
+
+    void add(const EnumDecl &Decl, SourceManager &Sources) {
+        if (Decl.isDependentType()) { return; }
+
+        auto name = Decl.getQualifiedNameAsString();
+        auto file = Sources.getFilename(Sources.getSpellingLoc(Decl.getLocation()));
+        if (!Seen.insert(getRecordKey(name, file)).second) { return; }
+
+        raw_string_ostream OS(Output);
+        OS << "enum\t" << name << "\t" << file << "\n";
+        for (const auto *enumerator : Decl.enumerators()) {
+            OS << "enumerator\t" << enumerator->getName() << "\t"
+               << enumerator->getInitVal().toString(10) << "\n";
+        }
+    }
+
+public:
+    std::unique_ptr<ASTConsumer> createASTConsumer(CompilerInstance &CI) override {
+        return llvm::make_unique<Consumer>(*this, CI.getSourceManager());
+    }
+
+    bool usesASTConsumer() const override { return true; }
+
+    void print(raw_ostream &Out) const override {
+        Out << Output;
+    }
+
+    void merge(StringRef Printed) override {
+        mergeNamedRecords(Printed, "enum", 1, Seen, Output);
+    }
+};
+
+}
+
+static AnalysisRegistry::Add<EnumAnalysis>
+    X("enums", "enumerations and the values of their enumerators");
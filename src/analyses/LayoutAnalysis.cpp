@@ -0,0 +1,63 @@
+#include "Analysis.h"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/RecordLayout.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/StringSet.h"
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace llvm;
+
+namespace {
+
+// Size, alignment and field offsets of every complete record, printed as
+//   layout  <qualified name>  <size>  <alignment>  <file>
+//   field   <name>  <offset in bits>  <type>
+class LayoutAnalysis : public Analysis, public MatchFinder::MatchCallback {
+    std::string Output;
+    // Headers are parsed once per translation unit, report each record once.
+    StringSet<> Seen;
+
+public:
+    void addMatchers(MatcherList &Matchers) override {
+        Matchers.add(cxxRecordDecl(isDefinition()).bind("record"), this);
+    }
+
+    bool needsSerialMatching() const override { return true; }
+
+    void run(const MatchFinder::MatchResult &Result) override {
+        const auto *record = Result.Nodes.getNodeAs<CXXRecordDecl>("record");
+        if (record->isDependentType() || record->isInvalidDecl()) { return; }
+
+        const auto &sources = *Result.SourceManager;
+        auto name = record->getQualifiedNameAsString();
+        auto file = sources.getFilename(sources.getSpellingLoc(record->getLocation()));
+        if (!Seen.insert(getRecordKey(name, file)).second) { return; }
+
+        const auto &layout = Result.Context->getASTRecordLayout(record);
+        raw_string_ostream OS(Output);
+        OS << "layout\t" << name << "\t" << layout.getSize().getQuantity() << "\t"
+           << layout.getAlignment().getQuantity() << "\t" << file << "\n";
+
+        for (const auto *field : record->fields()) {
+            OS << "field\t" << field->getName() << "\t"
+               << layout.getFieldOffset(field->getFieldIndex()) << "\t"
+               << field->getType().getAsString() << "\n";
+        }
+    }
+
+    void print(raw_ostream &Out) const override {
+        Out << Output;
+    }
+
+    void merge(StringRef Printed) override {
+        mergeNamedRecords(Printed, "layout", 3, Seen, Output);
+    }
+};
+
+}
+
+static AnalysisRegistry::Add<LayoutAnalysis>
+    X("layouts", "size, alignment and field offsets of complete records");
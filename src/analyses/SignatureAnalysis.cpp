@@ -0,0 +1,32 @@
+#include "Analysis.h"
+
+#include "matchers/MatchProcessor.h"
+#include "results/ScanResults.h"
+
+using namespace llvm;
+
+namespace {
+
+// Classes and their method signatures, the tool's original output.
+class SignatureAnalysis : public Analysis {
+    ScanResults Results;
+    MatchProcessor Processor{ Results };
+
+public:
+    void addMatchers(MatcherList &Matchers) override {
+        addScanMatchers(Matchers, Processor);
+    }
+
+    void print(raw_ostream &OS) const override {
+        Results.print(OS);
+    }
+
+    void merge(StringRef Printed) override {
+        Results.parse(Printed);
+    }
+};
+
+}
+
+static AnalysisRegistry::Add<SignatureAnalysis>
+    X("signatures", "class definitions and their method signatures");
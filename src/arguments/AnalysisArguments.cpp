@@ -0,0 +1,134 @@
+#include "AnalysisArguments.h"
+
+#include "llvm/ADT/StringSet.h"
+#include "llvm/ADT/StringSwitch.h"
+
+using namespace clang::tooling;
+using namespace llvm;
+
+// Flags whose next argument is a value that must be left alone.
+static bool takesSeparateValue(StringRef Arg) {
+    return StringSwitch<bool>(Arg)
+        .Cases("-Xclang", "-Xpreprocessor", "-Xassembler", "-Xlinker", true)
+        .Cases("-mllvm", "-include", "-isystem", "-I", "-D", "-U", true)
+        .Cases("-o", "-x", true)
+        .Default(false);
+}
+
+static bool isDebugInfoFlag(StringRef Arg) {
+    if (!Arg.startswith("-g")) { return false; }
+
+    auto rest = Arg.drop_front(2);
+    return rest.empty() || (rest.size() == 1 && isdigit(rest[0])) ||
+           rest.startswith("gdb") || rest.startswith("dwarf") ||
+           rest.startswith("line-tables") || rest.startswith("split-dwarf") ||
+           rest.startswith("column-info") || rest.startswith("z");
+}
+
+static bool isCodeGenFlag(StringRef Arg) {
+    return (Arg.startswith("-O") && !Arg.startswith("-ObjC")) || Arg.startswith("-march=") ||
+           Arg.startswith("-mtune=") || Arg.startswith("-mcpu=") ||
+           Arg.startswith("-flto") || Arg.startswith("-fno-lto") ||
+           Arg == "-fuse-linker-plugin" ||
+           Arg.startswith("-fsanitize") || Arg.startswith("-fno-sanitize") ||
+           Arg.startswith("-fprofile") || Arg.startswith("-fno-profile") ||
+           Arg.startswith("-fcoverage") || Arg == "-ftest-coverage" ||
+           Arg.startswith("-fstack-protector") ||
+           Arg == "-fomit-frame-pointer" || Arg == "-fno-omit-frame-pointer" ||
+           Arg == "-ffunction-sections" || Arg == "-fdata-sections" ||
+           Arg == "-funroll-loops" || Arg == "-fvectorize" || Arg == "-fslp-vectorize";
+}
+
+// Dependency file output, which would rewrite the build's .d files. Sets
+// Separate when the next argument is the flag's value.
+static bool isDependencyFileFlag(StringRef Arg, bool &Separate) {
+    Separate = Arg == "-MF" || Arg == "-MT" || Arg == "-MQ" || Arg == "-MJ";
+    return Separate || Arg.startswith("-MF") || Arg.startswith("-MT") ||
+           Arg.startswith("-MQ") || Arg.startswith("-MJ") || Arg.startswith("-Wp,-M") ||
+           StringSwitch<bool>(Arg)
+               .Cases("-M", "-MM", "-MD", "-MMD", "-MP", "-MG", "-MV", true)
+               .Default(false);
+}
+
+// -Wl, -Wa, and -Wp, forward options to other tools, they are not warnings.
+static bool isWarningFlag(StringRef Arg) {
+    if (Arg.startswith("-Wl,") || Arg.startswith("-Wa,") || Arg.startswith("-Wp,")) {
+        return false;
+    }
+    return Arg.startswith("-W") || Arg == "-w" || Arg == "-pedantic" ||
+           Arg == "-pedantic-errors";
+}
+
+static ArgumentsAdjuster getStripCodeGenAdjuster() {
+    return [](const CommandLineArguments &Args, StringRef) {
+        CommandLineArguments adjustedArgs;
+        for (size_t i = 0, e = Args.size(); i < e; ++i) {
+            StringRef arg = Args[i];
+
+            if (i > 0 && (isDebugInfoFlag(arg) || isCodeGenFlag(arg) || isWarningFlag(arg))) {
+                continue;
+            }
+            bool separate;
+            if (i > 0 && isDependencyFileFlag(arg, separate)) {
+                if (separate) { ++i; }
+                continue;
+            }
+
+            adjustedArgs.push_back(Args[i]);
+            if (takesSeparateValue(arg) && i + 1 < e) {
+                adjustedArgs.push_back(Args[++i]);
+            }
+        }
+        return adjustedArgs;
+    };
+}
+
+ArgumentsAdjuster getAnalysisArgumentsAdjuster() {
+    auto adjuster = combineAdjusters(getStripCodeGenAdjuster(), getClangStripOutputAdjuster());
+    adjuster = combineAdjusters(adjuster, getClangSyntaxOnlyAdjuster());
+
+    // Warnings are dropped above, -w also silences the ones on by default.
+    return combineAdjusters(adjuster, getInsertArgumentAdjuster("-w"));
+}
+
+std::string getCompileSettingsKey(const CompileCommand &Command) {
+    std::string key = Command.Directory;
+    for (const auto &arg : Command.CommandLine) {
+        if (arg == Command.Filename) { continue; }
+        key += '\0';
+        key += arg;
+    }
+    return key;
+}
+
+AnalysisCompilationDatabase::AnalysisCompilationDatabase(const CompilationDatabase &Base)
+    : Base(Base), Adjuster(getAnalysisArgumentsAdjuster()) {}
+
+std::vector<CompileCommand>
+AnalysisCompilationDatabase::adjust(std::vector<CompileCommand> Commands) const {
+    std::vector<CompileCommand> adjusted;
+    StringSet<> seen;
+
+    for (auto &command : Commands) {
+        command.CommandLine = Adjuster(command.CommandLine, command.Filename);
+
+        // Same settings for the same file only needs parsing once.
+        if (seen.insert(command.Filename + '\0' + getCompileSettingsKey(command)).second) {
+            adjusted.push_back(std::move(command));
+        }
+    }
+    return adjusted;
+}
+
+std::vector<CompileCommand>
+AnalysisCompilationDatabase::getCompileCommands(StringRef FilePath) const {
+    return adjust(Base.getCompileCommands(FilePath));
+}
+
+std::vector<std::string> AnalysisCompilationDatabase::getAllFiles() const {
+    return Base.getAllFiles();
+}
+
+std::vector<CompileCommand> AnalysisCompilationDatabase::getAllCompileCommands() const {
+    return adjust(Base.getAllCompileCommands());
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/CompilationDatabase.h"
+
+#include <string>
+
+// Rewrites a build command for AST analysis: -fsyntax-only, no output or
+// dependency files, and no optimisation, target tuning, LTO, debug info,
+// sanitizer, profiling or warning flags. None of these change the declarations the tool reads, but
+// several make the frontend do extra work.
+//
+// Note -O and -march also define macros (__OPTIMIZE__, __AVX2__, ...), code
+// conditional on those is seen as in a plain unoptimised build.
+clang::tooling::ArgumentsAdjuster getAnalysisArgumentsAdjuster();
+
+// Identifies the settings of an adjusted command independently of the file
+// it compiles, so translation units sharing their setup can be grouped.
+std::string getCompileSettingsKey(const clang::tooling::CompileCommand &Command);
+
+// Serves the commands of Base adjusted by getAnalysisArgumentsAdjuster().
+// Commands for the same file that differ only in dropped flags, e.g. a file
+// built in a debug and a release target, collapse into one.
+class AnalysisCompilationDatabase : public clang::tooling::CompilationDatabase {
+    const clang::tooling::CompilationDatabase &Base;
+    clang::tooling::ArgumentsAdjuster Adjuster;
+
+public:
+    explicit AnalysisCompilationDatabase(const clang::tooling::CompilationDatabase &Base);
+
+    std::vector<clang::tooling::CompileCommand>
+    getCompileCommands(llvm::StringRef FilePath) const override;
+
+    std::vector<std::string> getAllFiles() const override;
+
+    std::vector<clang::tooling::CompileCommand> getAllCompileCommands() const override;
+
+private:
+    std::vector<clang::tooling::CompileCommand>
+    adjust(std::vector<clang::tooling::CompileCommand> Commands) const;
+};
@@ -0,0 +1,394 @@
+#include "BinaryCompilationDatabase.h"
+
+#include "support/BinaryFile.h"
+
+#include "clang/Tooling/CompilationDatabasePluginRegistry.h"
+#include "clang/Tooling/JSONCompilationDatabase.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace {
+
+constexpr char Magic[] = { 'C', 'T', 'C', 'D', 'B', 0, 0, 0 };
+constexpr uint32_t Version = 2;
+
+// Header field offsets.
+enum : uint32_t {
+    VersionOffset = 8,
+    EntryCountOffset = 12,
+    ModTimeOffset = 16,
+    SizeOffset = 24,
+    HashOffset = 32,
+    EntriesOffset = 48,
+    CommandsOffset = 52,
+    CommandCountOffset = 56,
+    ArgumentsOffset = 60,
+    StringsOffset = 64,
+    StringsSizeOffset = 68,
+    BuildTimeOffset = 72,
+    ArgumentCountOffset = 80,
+    HeaderSize = 84
+};
+
+constexpr uint32_t EntrySize = 20;
+constexpr uint32_t CommandSize = 8;
+
+// Stand-ins for the per-entry file and output arguments, which keeps the
+// argument vectors of files built with the same flags identical.
+constexpr uint32_t FilePlaceholder = 0xFFFFFFFF;
+constexpr uint32_t OutputPlaceholder = 0xFFFFFFFE;
+
+std::string normalizePath(StringRef Directory, StringRef File) {
+    SmallString<256> path(File);
+    if (!sys::path::is_absolute(path)) {
+        path = Directory;
+        sys::path::append(path, File);
+    }
+    sys::path::remove_dots(path, /*remove_dot_dot=*/true);
+    sys::path::native(path);
+    return path.str();
+}
+
+uint64_t getSeconds(sys::TimePoint<> Time) {
+    return static_cast<uint64_t>(sys::toTimeT(Time));
+}
+
+std::string buildImage(const std::vector<CompileCommand> &Commands,
+                       const sys::fs::file_status &JsonStatus,
+                       const MD5::MD5Result &JsonHash) {
+    std::vector<std::string> keys;
+    keys.reserve(Commands.size());
+    for (const auto &command : Commands) {
+        keys.push_back(normalizePath(command.Directory, command.Filename));
+    }
+
+    std::vector<uint32_t> order(Commands.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+        [&](uint32_t LHS, uint32_t RHS) { return keys[LHS] < keys[RHS]; });
+
+    StringPoolBuilder strings;
+    StringMap<uint32_t> commandIndex;
+    std::vector<std::pair<uint32_t, uint32_t>> uniqueCommands;
+    std::vector<uint32_t> arguments;
+    BinaryWriter entries;
+
+    for (auto index : order) {
+        const auto &command = Commands[index];
+
+        SmallVector<uint32_t, 64> argv;
+        for (const auto &arg : command.CommandLine) {
+            if (arg == command.Filename) {
+                argv.push_back(FilePlaceholder);
+            } else if (!command.Output.empty() && arg == command.Output) {
+                argv.push_back(OutputPlaceholder);
+            } else {
+                argv.push_back(strings.add(arg));
+            }
+        }
+
+        auto key = StringRef(reinterpret_cast<const char *>(argv.data()),
+                             argv.size() * sizeof(uint32_t));
+        auto inserted = commandIndex.insert({ key, uniqueCommands.size() });
+        if (inserted.second) {
+            uniqueCommands.emplace_back(arguments.size(), argv.size());
+            arguments.insert(arguments.end(), argv.begin(), argv.end());
+        }
+
+        entries.write32(strings.add(keys[index]));
+        entries.write32(strings.add(command.Filename));
+        entries.write32(strings.add(command.Directory));
+        entries.write32(strings.add(command.Output));
+        entries.write32(inserted.first->second);
+    }
+
+    BinaryWriter image;
+    image.writeBytes(StringRef(Magic, sizeof(Magic)));
+    image.write32(Version);
+    image.write32(Commands.size());
+    image.write64(getSeconds(JsonStatus.getLastModificationTime()));
+    image.write64(JsonStatus.getSize());
+    image.writeBytes(StringRef(reinterpret_cast<const char *>(JsonHash), sizeof(JsonHash)));
+    while (image.size() < BuildTimeOffset) {
+        image.write32(0);
+    }
+    image.write64(getSeconds(std::chrono::system_clock::now()));
+    image.write32(arguments.size());
+
+    image.patch32(EntriesOffset, image.size());
+    image.writeBytes(entries.data());
+
+    image.patch32(CommandsOffset, image.size());
+    image.patch32(CommandCountOffset, uniqueCommands.size());
+    for (const auto &command : uniqueCommands) {
+        image.write32(command.first);
+        image.write32(command.second);
+    }
+
+    image.patch32(ArgumentsOffset, image.size());
+    for (auto arg : arguments) {
+        image.write32(arg);
+    }
+
+    image.patch32(StringsOffset, image.size());
+    image.patch32(StringsSizeOffset, strings.data().size());
+    image.writeBytes(strings.data());
+
+    return image.data();
+}
+
+// Checks the header and that every section lies inside the buffer, which
+// takes the same time however large the database. The offsets stored in
+// the sections are only checked as the accessors below read them, so a
+// load does not walk every entry.
+bool isWellFormed(StringRef Image) {
+    if (Image.size() < HeaderSize || !Image.startswith(StringRef(Magic, sizeof(Magic))) ||
+        read32(Image.data(), VersionOffset) != Version) {
+        return false;
+    }
+
+    auto *data = Image.data();
+    uint64_t size = Image.size();
+    auto within = [&](uint32_t Offset, uint64_t Count, uint64_t Width) {
+        return Offset >= HeaderSize && Offset + Count * Width <= size;
+    };
+
+    const auto entries = read32(data, EntriesOffset);
+    const auto entryCount = read32(data, EntryCountOffset);
+    const auto commands = read32(data, CommandsOffset);
+    const auto commandCount = read32(data, CommandCountOffset);
+    const auto arguments = read32(data, ArgumentsOffset);
+    const auto argumentCount = read32(data, ArgumentCountOffset);
+    const auto strings = read32(data, StringsOffset);
+    const auto stringsSize = read32(data, StringsSizeOffset);
+
+    if (!within(entries, entryCount, EntrySize) || !within(commands, commandCount, CommandSize) ||
+        !within(arguments, argumentCount, 4) || !within(strings, stringsSize, 1)) {
+        return false;
+    }
+
+    // A pool that does not end in NUL would let the last string run past it.
+    return !stringsSize || data[strings + stringsSize - 1] == 0;
+}
+
+bool hashFile(StringRef Path, MD5::MD5Result &Hash,
+              std::unique_ptr<MemoryBuffer> *Contents = nullptr) {
+    auto buffer = MemoryBuffer::getFile(Path, -1, /*RequiresNullTerminator=*/false);
+    if (!buffer) { return false; }
+
+    MD5 md5;
+    md5.update((*buffer)->getBuffer());
+    md5.final(Hash);
+
+    if (Contents) { *Contents = std::move(*buffer); }
+    return true;
+}
+
+enum class Freshness { Current, Touched, Stale };
+
+// The modification time and size are a cheap first check. Times have
+// whole second resolution, so they are only trusted for a JSON file last
+// modified before the second the cache was written; one rewritten within
+// that second would otherwise look unchanged. Anything else is compared by
+// hash, and a touched but otherwise unchanged file is reported so the cache
+// can record its new time.
+Freshness getFreshness(StringRef Image, StringRef JsonPath,
+                       const sys::fs::file_status &JsonStatus) {
+    auto *data = Image.data();
+    auto modified = getSeconds(JsonStatus.getLastModificationTime());
+    if (read64(data, ModTimeOffset) == modified && read64(data, SizeOffset) == JsonStatus.getSize() &&
+        modified < read64(data, BuildTimeOffset)) {
+        return Freshness::Current;
+    }
+
+    MD5::MD5Result hash;
+    if (hashFile(JsonPath, hash) && std::equal(std::begin(hash), std::end(hash), data + HashOffset)) {
+        return Freshness::Touched;
+    }
+    return Freshness::Stale;
+}
+
+// Records the JSON file's current time and size in an otherwise unchanged
+// cache. Failing to write it only costs the next run another hash.
+void refreshTimes(StringRef CachePath, StringRef Image, const sys::fs::file_status &JsonStatus) {
+    std::string image = Image;
+    support::endian::write64le(&image[ModTimeOffset],
+                               getSeconds(JsonStatus.getLastModificationTime()));
+    support::endian::write64le(&image[SizeOffset], JsonStatus.getSize());
+    support::endian::write64le(&image[BuildTimeOffset],
+                               getSeconds(std::chrono::system_clock::now()));
+    writeFileAtomically(CachePath, image);
+}
+
+class BinaryCompilationDatabasePlugin : public CompilationDatabasePlugin {
+    std::unique_ptr<CompilationDatabase>
+    loadFromDirectory(StringRef Directory, std::string &ErrorMessage) override {
+        SmallString<1024> jsonDatabasePath(Directory);
+        sys::path::append(jsonDatabasePath, "compile_commands.json");
+        return BinaryCompilationDatabase::loadFromJSON(jsonDatabasePath, ErrorMessage);
+    }
+};
+
+} // namespace
+
+// Objects of the executable are initialized ahead of the clangTooling
+// library, so this is tried before the JSON plugin.
+static CompilationDatabasePluginRegistry::Add<BinaryCompilationDatabasePlugin>
+X("binary-compilation-database",
+  "Reads compile_commands.json through a memory mapped binary cache");
+
+std::unique_ptr<BinaryCompilationDatabase>
+BinaryCompilationDatabase::loadFromJSON(StringRef JsonPath, std::string &ErrorMessage) {
+    sys::fs::file_status jsonStatus;
+    if (sys::fs::status(JsonPath, jsonStatus) || !sys::fs::is_regular_file(jsonStatus)) {
+        ErrorMessage = ("cannot find " + JsonPath).str();
+        return nullptr;
+    }
+
+    SmallString<1024> cachePath(JsonPath);
+    sys::path::replace_extension(cachePath, "bin");
+
+    auto cache = MemoryBuffer::getFile(cachePath, -1, /*RequiresNullTerminator=*/false);
+    if (cache && isWellFormed((*cache)->getBuffer())) {
+        auto freshness = getFreshness((*cache)->getBuffer(), JsonPath, jsonStatus);
+        if (freshness == Freshness::Touched) {
+            refreshTimes(cachePath, (*cache)->getBuffer(), jsonStatus);
+        }
+        if (freshness != Freshness::Stale) {
+            return std::unique_ptr<BinaryCompilationDatabase>(
+                new BinaryCompilationDatabase(std::move(*cache)));
+        }
+    }
+
+    MD5::MD5Result jsonHash;
+    std::unique_ptr<MemoryBuffer> jsonContents;
+    if (!hashFile(JsonPath, jsonHash, &jsonContents)) {
+        ErrorMessage = ("cannot read " + JsonPath).str();
+        return nullptr;
+    }
+
+    auto json = JSONCompilationDatabase::loadFromBuffer(
+        jsonContents->getBuffer(), ErrorMessage, JSONCommandLineSyntax::AutoDetect);
+    if (!json) { return nullptr; }
+
+    auto image = buildImage(json->getAllCompileCommands(), jsonStatus, jsonHash);
+
+    if (!writeFileAtomically(cachePath, image)) {
+        cache = MemoryBuffer::getFile(cachePath, -1, /*RequiresNullTerminator=*/false);
+        if (cache && isWellFormed((*cache)->getBuffer())) {
+            return std::unique_ptr<BinaryCompilationDatabase>(
+                new BinaryCompilationDatabase(std::move(*cache)));
+        }
+    }
+
+    // Read-only build directory, serve this run from memory.
+    return std::unique_ptr<BinaryCompilationDatabase>(
+        new BinaryCompilationDatabase(MemoryBuffer::getMemBufferCopy(image, cachePath)));
+}
+
+uint32_t BinaryCompilationDatabase::entryCount() const {
+    return read32(Buffer->getBufferStart(), EntryCountOffset);
+}
+
+StringRef BinaryCompilationDatabase::fileAt(uint32_t Index) const {
+    auto *data = Buffer->getBufferStart();
+    auto strings = StringRef(data + read32(data, StringsOffset), read32(data, StringsSizeOffset));
+    return readString(strings, read32(data, read32(data, EntriesOffset) + Index * EntrySize));
+}
+
+bool BinaryCompilationDatabase::commandAt(uint32_t Index, CompileCommand &Command) const {
+    auto *data = Buffer->getBufferStart();
+    auto strings = StringRef(data + read32(data, StringsOffset), read32(data, StringsSizeOffset));
+    auto entry = read32(data, EntriesOffset) + Index * EntrySize;
+
+    for (uint32_t field = 4; field < 16; field += 4) {
+        if (read32(data, entry + field) >= strings.size()) { return false; }
+    }
+    auto filename = readString(strings, read32(data, entry + 4));
+    auto directory = readString(strings, read32(data, entry + 8));
+    auto output = readString(strings, read32(data, entry + 12));
+
+    auto commandIndex = read32(data, entry + 16);
+    if (commandIndex >= read32(data, CommandCountOffset)) { return false; }
+    auto command = read32(data, CommandsOffset) + commandIndex * CommandSize;
+    auto firstArgument = read32(data, command);
+    auto argumentCount = read32(data, command + 4);
+    if (uint64_t(firstArgument) + argumentCount > read32(data, ArgumentCountOffset)) {
+        return false;
+    }
+    auto arguments = read32(data, ArgumentsOffset);
+
+    std::vector<std::string> commandLine;
+    commandLine.reserve(argumentCount);
+    for (auto i = firstArgument; i < firstArgument + argumentCount; ++i) {
+        auto arg = read32(data, arguments + i * 4);
+        if (arg == FilePlaceholder) {
+            commandLine.push_back(filename);
+        } else if (arg == OutputPlaceholder) {
+            commandLine.push_back(output);
+        } else if (arg < strings.size()) {
+            commandLine.push_back(readString(strings, arg));
+        } else {
+            return false;
+        }
+    }
+
+    Command = CompileCommand(directory, filename, std::move(commandLine), output);
+    return true;
+}
+
+std::vector<CompileCommand>
+BinaryCompilationDatabase::getCompileCommands(StringRef FilePath) const {
+    SmallString<256> currentDirectory;
+    sys::fs::current_path(currentDirectory);
+    auto key = normalizePath(currentDirectory, FilePath);
+
+    uint32_t first = 0;
+    uint32_t count = entryCount();
+    while (count > 0) {
+        auto step = count / 2;
+        if (fileAt(first + step) < key) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+
+    std::vector<CompileCommand> commands;
+    for (auto i = first; i < entryCount() && fileAt(i) == key; ++i) {
+        CompileCommand command;
+        if (commandAt(i, command)) { commands.push_back(std::move(command)); }
+    }
+    return commands;
+}
+
+std::vector<std::string> BinaryCompilationDatabase::getAllFiles() const {
+    std::vector<std::string> files;
+    for (uint32_t i = 0, e = entryCount(); i < e; ++i) {
+        if (files.empty() || files.back() != fileAt(i)) {
+            files.push_back(fileAt(i));
+        }
+    }
+    return files;
+}
+
+std::vector<CompileCommand> BinaryCompilationDatabase::getAllCompileCommands() const {
+    std::vector<CompileCommand> commands;
+    commands.reserve(entryCount());
+    for (uint32_t i = 0, e = entryCount(); i < e; ++i) {
+        CompileCommand command;
+        if (commandAt(i, command)) { commands.push_back(std::move(command)); }
+    }
+    return commands;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "clang/Tooling/CompilationDatabase.h"
+
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <memory>
+
+// A compilation database read in place from a memory mapped binary cache of
+// compile_commands.json. The cache sits next to the JSON file as
+// compile_commands.bin and is rebuilt whenever the JSON's content hash no
+// longer matches the one recorded in it. The hash is only computed when the
+// JSON's modification time or size changed since the cache was written.
+//
+// Layout, all values little endian u32 unless noted:
+//   header   magic "CTCDB\0\0\0", version, entry count, JSON mtime (u64),
+//            JSON size (u64), JSON MD5 (16 bytes), then the offsets of the
+//            entry, command, argument and string sections, the command
+//            count, the time the cache was written (u64) and the argument
+//            count
+//   entries  {file, directory, output, command} sorted by file path
+//   commands {first argument, argument count}, each unique argument vector
+//            stored once with the file and output replaced by placeholders
+//   arguments string offsets
+//   strings  deduplicated NUL terminated strings
+//
+// Lookups binary search the entry table, so nothing is parsed at startup.
+// Loading only checks the header and section bounds; the offsets inside an
+// entry are checked when it is read, and entries that point outside their
+// sections are left out.
+class BinaryCompilationDatabase : public clang::tooling::CompilationDatabase {
+    std::unique_ptr<llvm::MemoryBuffer> Buffer;
+
+    explicit BinaryCompilationDatabase(std::unique_ptr<llvm::MemoryBuffer> Buffer)
+        : Buffer(std::move(Buffer)) {}
+
+public:
+    // Opens the cache for JsonPath, building or refreshing it if required.
+    // Falls back to an in-memory image if the cache cannot be written.
+    static std::unique_ptr<BinaryCompilationDatabase>
+    loadFromJSON(llvm::StringRef JsonPath, std::string &ErrorMessage);
+
+    std::vector<clang::tooling::CompileCommand>
+    getCompileCommands(llvm::StringRef FilePath) const override;
+
+    std::vector<std::string> getAllFiles() const override;
+
+    std::vector<clang::tooling::CompileCommand> getAllCompileCommands() const override;
+
+private:
+    uint32_t entryCount() const;
+    // Empty if the entry's path lies outside the string pool.
+    llvm::StringRef fileAt(uint32_t Index) const;
+    // False if any of the entry's offsets lies outside its section.
+    bool commandAt(uint32_t Index, clang::tooling::CompileCommand &Command) const;
+};
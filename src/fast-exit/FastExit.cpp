@@ -0,0 +1,69 @@
+#include "FastExit.h"
+
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/Utils.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace {
+
+class FastExitActionFactory : public FrontendActionFactory {
+    std::unique_ptr<FrontendActionFactory> Factory;
+    unsigned Remaining;
+
+public:
+    FastExitActionFactory(std::unique_ptr<FrontendActionFactory> Factory, unsigned Units)
+        : Factory(std::move(Factory)), Remaining(Units) {}
+
+    FrontendAction *create() override { return Factory->create(); }
+
+    bool runInvocation(std::shared_ptr<CompilerInvocation> Invocation, FileManager *Files,
+                       std::shared_ptr<PCHContainerOperations> PCHContainerOps,
+                       DiagnosticConsumer *DiagConsumer) override {
+        // Leaking every unit would hold every AST of the run at once.
+        if (!Remaining || --Remaining != 0) {
+            return FrontendActionFactory::runInvocation(std::move(Invocation), Files,
+                                                        std::move(PCHContainerOps), DiagConsumer);
+        }
+
+        // As FrontendActionFactory::runInvocation, but the compiler instance
+        // and the action are buried instead of destroyed on return.
+        Invocation->getFrontendOpts().DisableFree = true;
+        auto compiler = llvm::make_unique<CompilerInstance>(std::move(PCHContainerOps));
+        compiler->setInvocation(std::move(Invocation));
+        compiler->setFileManager(Files);
+        std::unique_ptr<FrontendAction> action(create());
+
+        compiler->createDiagnostics(DiagConsumer, /*ShouldOwnClient=*/false);
+        if (!compiler->hasDiagnostics()) { return false; }
+        compiler->createSourceManager(*Files);
+
+        auto succeeded = compiler->ExecuteAction(*action);
+        Files->clearStatCaches();
+        BuryPointer(std::move(action));
+        BuryPointer(std::move(compiler));
+        return succeeded;
+    }
+};
+
+}
+
+std::unique_ptr<FrontendActionFactory>
+newFastExitActionFactory(std::unique_ptr<FrontendActionFactory> Factory, unsigned Units) {
+    return llvm::make_unique<FastExitActionFactory>(std::move(Factory), Units);
+}
+
+void exitFast(int Ret) {
+    outs().flush();
+    errs().flush();
+    std::fflush(nullptr);
+    std::_Exit(Ret);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/Compiler.h"
+
+#include <memory>
+
+// Process teardown for runs that are about to end anyway: the last
+// translation unit leaks its compiler instance, AST, Sema and consumers the
+// way clang's -disable-free does, and the process ends without running
+// destructors.
+//
+// ClangTool clears -disable-free from every command, so the wrapper sets it
+// on the invocation itself, and runs the last invocation on a compiler
+// instance of its own that it can leak.
+
+// Runs Factory's actions, leaking the frontend state of the last of Units
+// invocations instead of freeing it.
+std::unique_ptr<clang::tooling::FrontendActionFactory>
+newFastExitActionFactory(std::unique_ptr<clang::tooling::FrontendActionFactory> Factory,
+                         unsigned Units);
+
+// Flushes the standard streams and ends the process with Ret, skipping
+// destructors and atexit handlers.
+LLVM_ATTRIBUTE_NORETURN void exitFast(int Ret);
@@ -0,0 +1,135 @@
+#include "SharedFileCache.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Path.h"
+
+using namespace clang;
+using namespace llvm;
+
+namespace {
+
+// A file whose contents are owned by SharedFileCache for the whole run.
+class CachedFile : public vfs::File {
+    vfs::Status Status;
+    StringRef Contents;
+
+public:
+    CachedFile(vfs::Status Status, StringRef Contents)
+        : Status(std::move(Status)), Contents(Contents) {}
+
+    ErrorOr<vfs::Status> status() override { return Status; }
+
+    ErrorOr<std::unique_ptr<MemoryBuffer>>
+    getBuffer(const Twine &Name, int64_t FileSize, bool RequiresNullTerminator,
+              bool IsVolatile) override {
+        return MemoryBuffer::getMemBuffer(Contents, Name.str(), RequiresNullTerminator);
+    }
+
+    std::error_code close() override { return {}; }
+};
+
+} // namespace
+
+SharedFileCache &SharedFileCache::instance() {
+    static SharedFileCache cache;
+    return cache;
+}
+
+bool SharedFileCache::lookupStat(StringRef Path, bool &Exists, FileData &Data) {
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    auto it = Stats.find(Path);
+    if (it == Stats.end()) { return false; }
+
+    Exists = it->second.Exists;
+    Data = it->second.Data;
+    return true;
+}
+
+void SharedFileCache::addStat(StringRef Path, bool Exists, const FileData &Data) {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Stats.insert({ Path, StatEntry{ Exists, Data } });
+}
+
+std::unique_ptr<vfs::File> SharedFileCache::openCached(StringRef Path,
+                                                       const sys::fs::UniqueID &ID) {
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    auto it = Contents.find(ID);
+    if (it == Contents.end()) { return nullptr; }
+
+    return llvm::make_unique<CachedFile>(
+        vfs::Status::copyWithNewName(it->second.Status, Path),
+        it->second.Buffer->getBuffer());
+}
+
+std::unique_ptr<vfs::File> SharedFileCache::addContents(StringRef Path,
+                                                        StringRef AbsolutePath,
+                                                        const sys::fs::UniqueID &ID,
+                                                        vfs::File &File) {
+    auto status = File.status();
+    if (!status) { return nullptr; }
+
+    // Read outside the lock, another thread racing on the same file just
+    // loses its copy below.
+    auto buffer = File.getBuffer(Path);
+    if (!buffer) { return nullptr; }
+
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    auto inserted = Contents.insert({ ID, ContentEntry{
+        vfs::Status::copyWithNewName(*status, AbsolutePath), std::move(*buffer) } });
+    const auto &entry = inserted.first->second;
+
+    return llvm::make_unique<CachedFile>(
+        vfs::Status::copyWithNewName(entry.Status, Path), entry.Buffer->getBuffer());
+}
+
+void SharedFileCache::forEachFile(function_ref<void(StringRef, StringRef)> Callback) {
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    for (const auto &entry : Contents) {
+        Callback(entry.second.Status.getName(), entry.second.Buffer->getBuffer());
+    }
+}
+
+FileSystemStatCache::LookupResult
+SharedStatCache::getStat(StringRef Path, FileData &Data, bool isFile,
+                         std::unique_ptr<vfs::File> *F, vfs::FileSystem &FS) {
+    auto &cache = SharedFileCache::instance();
+
+    // ClangTool changes directory for every compile command, so relative
+    // paths are only meaningful once made absolute.
+    SmallString<256> absolutePath(Path);
+    FS.makeAbsolute(absolutePath);
+    sys::path::remove_dots(absolutePath);
+
+    bool exists;
+    if (cache.lookupStat(absolutePath, exists, Data)) {
+        if (!exists) { return CacheMissing; }
+
+        Data.Name = Path;
+        if (F && !Data.IsDirectory) {
+            *F = cache.openCached(Path, Data.UniqueID);
+            if (!*F) {
+                // Only stat'ed so far, read it once now.
+                if (auto file = FS.openFileForRead(Path)) {
+                    *F = cache.addContents(Path, absolutePath, Data.UniqueID, **file);
+                }
+            }
+        }
+        return CacheExists;
+    }
+
+    auto result = statChained(Path, Data, isFile, F, FS);
+    cache.addStat(absolutePath, result == CacheExists, Data);
+
+    if (result == CacheExists && F && *F) {
+        if (auto shared = cache.addContents(Path, absolutePath, Data.UniqueID, **F)) {
+            *F = std::move(shared);
+        }
+    }
+
+    return result;
+}
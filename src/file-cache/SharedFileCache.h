@@ -0,0 +1,66 @@
+#pragma once
+
+#include "clang/Basic/FileSystemStatCache.h"
+#include "clang/Basic/VirtualFileSystem.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Process wide record of stat results and file contents. Every FileManager in
+// the run consults it through a SharedStatCache, so a header is stat'ed and
+// read once no matter how many translation units or threads include it.
+//
+// Results are never invalidated: files are assumed not to change while the
+// tool is running.
+class SharedFileCache {
+    struct StatEntry {
+        bool Exists;
+        clang::FileData Data;
+    };
+
+    struct ContentEntry {
+        clang::vfs::Status Status;
+        std::unique_ptr<llvm::MemoryBuffer> Buffer;
+    };
+
+    std::mutex Mutex;
+    llvm::StringMap<StatEntry> Stats;
+    std::map<llvm::sys::fs::UniqueID, ContentEntry> Contents;
+
+public:
+    static SharedFileCache &instance();
+
+    // Returns false if Path has not been stat'ed yet.
+    bool lookupStat(llvm::StringRef Path, bool &Exists, clang::FileData &Data);
+    void addStat(llvm::StringRef Path, bool Exists, const clang::FileData &Data);
+
+    // Returns a file reading from the cached contents, or null if the file has
+    // not been read yet.
+    std::unique_ptr<clang::vfs::File> openCached(llvm::StringRef Path,
+                                                 const llvm::sys::fs::UniqueID &ID);
+
+    // Reads File once and keeps its contents under AbsolutePath, returning a
+    // file over them named Path.
+    std::unique_ptr<clang::vfs::File> addContents(llvm::StringRef Path,
+                                                  llvm::StringRef AbsolutePath,
+                                                  const llvm::sys::fs::UniqueID &ID,
+                                                  clang::vfs::File &File);
+
+    // Visits the absolute path and contents of every file read so far.
+    void forEachFile(llvm::function_ref<void(llvm::StringRef, llvm::StringRef)> Callback);
+};
+
+// FileManager stat cache backed by SharedFileCache. Installed on ClangTool's
+// FileManager, it also hands out files over the shared contents so that each
+// SourceManager maps the same buffer instead of reading the file again.
+class SharedStatCache : public clang::FileSystemStatCache {
+protected:
+    LookupResult getStat(llvm::StringRef Path, clang::FileData &Data, bool isFile,
+                         std::unique_ptr<clang::vfs::File> *F,
+                         clang::vfs::FileSystem &FS) override;
+};
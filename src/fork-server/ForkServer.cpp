@@ -0,0 +1,125 @@
+#include "ForkServer.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/raw_ostream.h"
+
+#ifndef _WIN32
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+
+#ifdef _WIN32
+
+int runForkServer(StringRef SocketPath,
+                  function_ref<int(ArrayRef<std::string>)> RunTool) {
+    errs() << "error: --fork-server is not supported on Windows\n";
+    return 1;
+}
+
+#else
+
+// Reads the request until the terminating empty line. Returns false if the
+// client hung up before finishing it.
+static bool readRequest(int Fd, std::vector<std::string> &SourcePaths) {
+    SmallString<256> Line;
+    char Buffer[4096];
+
+    for (;;) {
+        auto count = ::read(Fd, Buffer, sizeof(Buffer));
+        if (count <= 0) { return false; }
+
+        for (auto i = 0; i < count; ++i) {
+            if (Buffer[i] != '\n') {
+                Line.push_back(Buffer[i]);
+                continue;
+            }
+
+            auto path = StringRef(Line).trim();
+            if (path.empty()) { return true; }
+
+            SourcePaths.push_back(path.str());
+            Line.clear();
+        }
+    }
+}
+
+static void serveConnection(int Fd,
+                            function_ref<int(ArrayRef<std::string>)> RunTool) {
+    std::vector<std::string> sourcePaths;
+    if (!readRequest(Fd, sourcePaths)) { ::_exit(1); }
+
+    ::dup2(Fd, STDOUT_FILENO);
+    ::dup2(Fd, STDERR_FILENO);
+
+    auto ret = sourcePaths.empty() ? 0 : RunTool(sourcePaths);
+
+    outs() << "exit " << ret << "\n";
+    outs().flush();
+    errs().flush();
+
+    // Nothing the parent built needs tearing down; the kernel reclaims it.
+    ::_exit(ret);
+}
+
+int runForkServer(StringRef SocketPath,
+                  function_ref<int(ArrayRef<std::string>)> RunTool) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (SocketPath.size() >= sizeof(address.sun_path)) {
+        errs() << "error: socket path too long: " << SocketPath << "\n";
+        return 1;
+    }
+    std::memcpy(address.sun_path, SocketPath.data(), SocketPath.size());
+
+    auto listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        errs() << "error: socket: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    ::unlink(address.sun_path);
+    if (::bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd, SOMAXCONN) != 0) {
+        errs() << "error: cannot listen on " << SocketPath << ": "
+               << std::strerror(errno) << "\n";
+        ::close(listenFd);
+        return 1;
+    }
+
+    // Children are never waited on, let the kernel reap them.
+    ::signal(SIGCHLD, SIG_IGN);
+
+    errs() << "fork-server listening on " << SocketPath << "\n";
+
+    for (;;) {
+        auto fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) { continue; }
+            errs() << "error: accept: " << std::strerror(errno) << "\n";
+            break;
+        }
+
+        auto pid = ::fork();
+        if (pid == 0) {
+            ::close(listenFd);
+            serveConnection(fd, RunTool);
+        }
+
+        if (pid < 0) {
+            errs() << "error: fork: " << std::strerror(errno) << "\n";
+        }
+
+        ::close(fd);
+    }
+
+    ::close(listenFd);
+    return 1;
+}
+
+#endif
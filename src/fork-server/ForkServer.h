@@ -0,0 +1,20 @@
+#pragma once
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <string>
+
+// Serves tool runs from a pre-initialized parent process listening on a UNIX
+// domain socket. Each connection is handled by a forked child which inherits
+// the parsed options and the loaded compilation database, so a request only
+// pays for the files it names.
+//
+// A request is one source path per line, terminated by an empty line, e.g.
+//   printf 'src/main.cpp\n\n' | nc -U /tmp/tool.sock
+// The child streams the tool output back and finishes with "exit <code>\n".
+//
+// Returns only on setup failure; the server runs until it is killed.
+int runForkServer(llvm::StringRef SocketPath,
+                  llvm::function_ref<int(llvm::ArrayRef<std::string>)> RunTool);
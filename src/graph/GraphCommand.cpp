@@ -0,0 +1,252 @@
+#include "GraphCommand.h"
+
+#include "graph/TypeGraph.h"
+
+#include "arguments/AnalysisArguments.h"
+#include "file-cache/SharedFileCache.h"
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/Tooling.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/Support/CommandLine.h"
+
+#include <thread>
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+static cl::OptionCategory GraphCategory("graph options");
+
+static cl::opt<std::string> GraphFile(
+    "graph-file", cl::desc("Type graph to write, or to read for queries"),
+    cl::value_desc("file"), cl::cat(GraphCategory));
+
+static cl::opt<std::string> Exposing(
+    "exposing", cl::desc("Print the public methods exposing this qualified type name"),
+    cl::value_desc("type"), cl::cat(GraphCategory));
+
+static cl::opt<unsigned> GraphJobs(
+    "graph-jobs", cl::desc("Threads searching the graph (default: one per core)"),
+    cl::init(0), cl::cat(GraphCategory));
+
+namespace {
+
+// Adds the declarations of one translation unit to the graph. Types are
+// followed through pointers, references, arrays and sugar to the typedef,
+// record or other type they name, and into the parameter and return types
+// of function types and the type arguments of template specializations.
+class GraphVisitor : public RecursiveASTVisitor<GraphVisitor> {
+    typegraph::Builder &Graph;
+    ASTContext &Context;
+    DenseSet<const TypedefNameDecl *> Typedefs;
+
+    void addTypeEdge(uint32_t From, QualType Type) {
+        while (!Type.isNull()) {
+            const auto *type = Type.getTypePtr();
+            if (const auto *typedefType = dyn_cast<TypedefType>(type)) {
+                Graph.addEdge(From, addTypedef(typedefType->getDecl()));
+                return;
+            }
+            if (isa<PointerType>(type) || isa<ReferenceType>(type) ||
+                isa<MemberPointerType>(type)) {
+                Type = type->getPointeeType();
+                continue;
+            }
+            if (const auto *array = dyn_cast<ArrayType>(type)) {
+                Type = array->getElementType();
+                continue;
+            }
+            if (const auto *function = dyn_cast<FunctionType>(type)) {
+                if (const auto *prototype = dyn_cast<FunctionProtoType>(function)) {
+                    for (auto parameter : prototype->getParamTypes()) {
+                        addTypeEdge(From, parameter);
+                    }
+                }
+                Type = function->getReturnType();
+                continue;
+            }
+            if (const auto *specialization = dyn_cast<TemplateSpecializationType>(type)) {
+                addTemplateArgumentEdges(From, specialization->template_arguments());
+            }
+
+            auto desugared = Type.getSingleStepDesugaredType(Context);
+            if (desugared != Type) {
+                Type = desugared;
+                continue;
+            }
+
+            if (const auto *record = type->getAsCXXRecordDecl()) {
+                Graph.addEdge(From, Graph.addNode(typegraph::Class,
+                                                  record->getQualifiedNameAsString()));
+                // Reached without the sugar that spells the arguments.
+                if (const auto *specialization =
+                        dyn_cast<ClassTemplateSpecializationDecl>(record)) {
+                    addTemplateArgumentEdges(From, specialization->getTemplateArgs().asArray());
+                }
+            } else if (const auto *tag = type->getAsTagDecl()) {
+                Graph.addEdge(From, Graph.addNode(typegraph::Type, tag->getQualifiedNameAsString()));
+            } else {
+                Graph.addEdge(From, Graph.addNode(typegraph::Type,
+                                                  Type.getUnqualifiedType().getAsString()));
+            }
+            return;
+        }
+    }
+
+    void addTemplateArgumentEdges(uint32_t From, ArrayRef<TemplateArgument> Arguments) {
+        for (const auto &argument : Arguments) {
+            if (argument.getKind() == TemplateArgument::Type) {
+                addTypeEdge(From, argument.getAsType());
+            } else if (argument.getKind() == TemplateArgument::Pack) {
+                addTemplateArgumentEdges(From, argument.pack_elements());
+            }
+        }
+    }
+
+    uint32_t addTypedef(const TypedefNameDecl *Decl) {
+        auto node = Graph.addNode(typegraph::Typedef, Decl->getQualifiedNameAsString());
+        if (Typedefs.insert(Decl).second) {
+            addTypeEdge(node, Decl->getUnderlyingType());
+        }
+        return node;
+    }
+
+    static std::string getMethodName(const CXXMethodDecl &Method) {
+        std::string name = Method.getQualifiedNameAsString() + "(";
+        for (unsigned i = 0; i < Method.getNumParams(); ++i) {
+            if (i) { name += ", "; }
+            name += Method.getParamDecl(i)->getType().getAsString();
+        }
+        name += ")";
+        if (Method.isConst()) { name += " const"; }
+        return name;
+    }
+
+public:
+    GraphVisitor(typegraph::Builder &Graph, ASTContext &Context)
+        : Graph(Graph), Context(Context) {}
+
+    bool VisitCXXRecordDecl(CXXRecordDecl *D) {
+        if (!D->isThisDeclarationADefinition()) { return true; }
+
+        auto record = Graph.addNode(typegraph::Class, D->getQualifiedNameAsString());
+        // methods() skips member function templates.
+        for (const auto *member : D->decls()) {
+            if (const auto *templ = dyn_cast<FunctionTemplateDecl>(member)) {
+                member = templ->getTemplatedDecl();
+            }
+            const auto *method = dyn_cast<CXXMethodDecl>(member);
+            if (!method || method->isImplicit()) { continue; }
+
+            auto node = Graph.addNode(typegraph::Method, getMethodName(*method),
+                                      method->getAccess() == AS_public);
+            Graph.addEdge(record, node);
+            addTypeEdge(node, method->getReturnType());
+            for (const auto *parameter : method->parameters()) {
+                addTypeEdge(node, parameter->getType());
+            }
+        }
+        return true;
+    }
+
+    bool VisitTypedefNameDecl(TypedefNameDecl *D) {
+        addTypedef(D);
+        return true;
+    }
+};
+
+class GraphConsumer : public ASTConsumer {
+    typegraph::Builder &Graph;
+
+public:
+    explicit GraphConsumer(typegraph::Builder &Graph) : Graph(Graph) {}
+
+    void HandleTranslationUnit(ASTContext &Context) override {
+        GraphVisitor(Graph, Context).TraverseDecl(Context.getTranslationUnitDecl());
+    }
+};
+
+class GraphAction : public ASTFrontendAction {
+    typegraph::Builder &Graph;
+
+public:
+    explicit GraphAction(typegraph::Builder &Graph) : Graph(Graph) {}
+
+    std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
+                                                   StringRef InFile) override {
+        return llvm::make_unique<GraphConsumer>(Graph);
+    }
+};
+
+class GraphActionFactory : public FrontendActionFactory {
+    typegraph::Builder &Graph;
+
+public:
+    explicit GraphActionFactory(typegraph::Builder &Graph) : Graph(Graph) {}
+
+    FrontendAction *create() override { return new GraphAction(Graph); }
+};
+
+} // namespace
+
+static int printExposingMethods(StringRef Path, StringRef TypeName) {
+    std::string errorMessage;
+    auto graph = typegraph::Graph::load(Path, errorMessage);
+    if (!graph) {
+        errs() << "error: " << errorMessage << "\n";
+        return 1;
+    }
+
+    auto types = graph->findNodes(TypeName);
+    if (types.empty()) {
+        errs() << "error: " << TypeName << " is not in " << Path << "\n";
+        return 1;
+    }
+
+    auto jobs = GraphJobs ? GraphJobs : std::max(1u, std::thread::hardware_concurrency());
+    for (auto method : graph->getExposingMethods(types, jobs)) {
+        outs() << "method\t" << graph->getName(method) << "\n";
+    }
+    return 0;
+}
+
+int runGraphCommand(int argc, const char **argv) {
+    CommonOptionsParser OptionsParser(argc, argv, GraphCategory, cl::ZeroOrMore);
+
+    if (GraphFile.empty()) {
+        errs() << "error: graph requires --graph-file=<file>\n";
+        return 1;
+    }
+
+    if (OptionsParser.getSourcePathList().empty()) {
+        if (Exposing.empty()) {
+            errs() << "error: graph requires source paths to read or --exposing=<type>\n";
+            return 1;
+        }
+        return printExposingMethods(GraphFile, Exposing);
+    }
+
+    AnalysisCompilationDatabase compilations(OptionsParser.getCompilations());
+    ClangTool Tool(compilations, OptionsParser.getSourcePathList());
+    Tool.getFiles().addStatCache(llvm::make_unique<SharedStatCache>());
+
+    typegraph::Builder graph;
+    GraphActionFactory factory(graph);
+    auto ret = Tool.run(&factory);
+
+    if (auto ec = graph.write(GraphFile)) {
+        errs() << "error: cannot write " << GraphFile << ": " << ec.message() << "\n";
+        return 1;
+    }
+
+    return ret;
+}
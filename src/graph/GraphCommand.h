@@ -0,0 +1,6 @@
+#pragma once
+
+// The "graph" subcommand. With source paths it writes their type graph to
+// the file named by --graph-file; without, it answers --exposing=<type>
+// from it, printing the public methods that expose the type.
+int runGraphCommand(int argc, const char **argv);
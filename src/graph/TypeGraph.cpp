@@ -0,0 +1,293 @@
+#include "TypeGraph.h"
+
+#include "llvm/Support/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace llvm;
+
+namespace {
+
+constexpr char Magic[] = { 'C', 'T', 'G', 'R', 'A', 'P', 'H', 0 };
+constexpr uint32_t Version = 1;
+
+enum : uint32_t {
+    VersionOffset = 8,
+    NodeCountOffset = 12,
+    EdgeCountOffset = 16,
+    KindsOffset = 20,
+    NamesOffset = 24,
+    ForwardOffsetsOffset = 28,
+    ForwardTargetsOffset = 32,
+    ReverseOffsetsOffset = 36,
+    ReverseTargetsOffset = 40,
+    StringsOffset = 44,
+    StringsSizeOffset = 48,
+    HeaderSize = 52
+};
+
+// Levels smaller than this are walked on the calling thread, handing them
+// to the pool costs more than it saves.
+constexpr size_t ParallelLevelSize = 4096;
+
+void writeRows(BinaryWriter &File, uint32_t OffsetsField, uint32_t TargetsField,
+               uint32_t NodeCount, std::vector<std::pair<uint32_t, uint32_t>> Edges) {
+    std::sort(Edges.begin(), Edges.end());
+
+    File.patch32(OffsetsField, File.size());
+    size_t edge = 0;
+    for (uint32_t node = 0; node <= NodeCount; ++node) {
+        while (edge < Edges.size() && Edges[edge].first < node) { ++edge; }
+        File.write32(edge);
+    }
+
+    File.patch32(TargetsField, File.size());
+    for (const auto &entry : Edges) {
+        File.write32(entry.second);
+    }
+}
+
+// Edge numbers never decrease and stay within the edge count, and every
+// target is a node.
+bool areRowsValid(const char *Data, uint32_t OffsetsField, uint32_t TargetsField,
+                  uint32_t NodeCount, uint32_t EdgeCount) {
+    auto offsets = read32(Data, OffsetsField);
+    auto targets = read32(Data, TargetsField);
+    uint32_t previous = 0;
+    for (uint32_t node = 0; node <= NodeCount; ++node) {
+        auto edge = read32(Data, offsets + node * 4);
+        if (edge < previous || edge > EdgeCount) { return false; }
+        previous = edge;
+    }
+    for (uint32_t edge = 0; edge < EdgeCount; ++edge) {
+        if (read32(Data, targets + edge * 4) >= NodeCount) { return false; }
+    }
+    return true;
+}
+
+} // namespace
+
+namespace typegraph {
+
+uint32_t Builder::addNode(NodeKind Kind, StringRef Name, bool IsPublic) {
+    auto key = (Twine(static_cast<char>('0' + Kind)) + Name).str();
+    auto inserted = Numbers.insert(std::make_pair(key, static_cast<uint32_t>(Nodes.size())));
+    if (inserted.second) {
+        Nodes.emplace_back(Name, Kind);
+    }
+    if (IsPublic) {
+        Nodes[inserted.first->second].second |= PublicFlag;
+    }
+    return inserted.first->second;
+}
+
+std::error_code Builder::write(StringRef Path) const {
+    std::vector<uint32_t> order(Nodes.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t Left, uint32_t Right) {
+        return Nodes[Left] < Nodes[Right];
+    });
+
+    std::vector<uint32_t> numbers(Nodes.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        numbers[order[i]] = i;
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> forward;
+    for (const auto &edge : Edges) {
+        forward.emplace_back(numbers[edge.first], numbers[edge.second]);
+    }
+    std::sort(forward.begin(), forward.end());
+    forward.erase(std::unique(forward.begin(), forward.end()), forward.end());
+
+    std::vector<std::pair<uint32_t, uint32_t>> reverse;
+    for (const auto &edge : forward) {
+        reverse.emplace_back(edge.second, edge.first);
+    }
+
+    StringPoolBuilder strings;
+    BinaryWriter file;
+    file.writeBytes(StringRef(Magic, sizeof(Magic)));
+    while (file.size() < HeaderSize) {
+        file.write32(0);
+    }
+    file.patch32(VersionOffset, Version);
+    file.patch32(NodeCountOffset, Nodes.size());
+    file.patch32(EdgeCountOffset, forward.size());
+
+    file.patch32(KindsOffset, file.size());
+    for (auto node : order) {
+        file.write8(Nodes[node].second);
+    }
+    file.align(4);
+    file.patch32(NamesOffset, file.size());
+    for (auto node : order) {
+        file.write32(strings.add(Nodes[node].first));
+    }
+
+    writeRows(file, ForwardOffsetsOffset, ForwardTargetsOffset, Nodes.size(), std::move(forward));
+    writeRows(file, ReverseOffsetsOffset, ReverseTargetsOffset, Nodes.size(), std::move(reverse));
+
+    file.patch32(StringsOffset, file.size());
+    file.patch32(StringsSizeOffset, strings.data().size());
+    file.writeBytes(strings.data());
+
+    return writeFileAtomically(Path, file.data());
+}
+
+std::unique_ptr<Graph> Graph::load(StringRef Path, std::string &ErrorMessage) {
+    auto buffer = MemoryBuffer::getFile(Path, -1, /*RequiresNullTerminator=*/false);
+    if (!buffer) {
+        ErrorMessage = ("cannot read " + Path + ": " + buffer.getError().message()).str();
+        return nullptr;
+    }
+
+    auto data = (*buffer)->getBuffer();
+    if (data.size() < HeaderSize || !data.startswith(StringRef(Magic, sizeof(Magic))) ||
+        read32(data.data(), VersionOffset) != Version) {
+        ErrorMessage = (Path + " is not a type graph written by this version").str();
+        return nullptr;
+    }
+
+    uint64_t nodes = read32(data.data(), NodeCountOffset);
+    uint64_t edges = read32(data.data(), EdgeCountOffset);
+    uint64_t stringsEnd = uint64_t(read32(data.data(), StringsOffset)) +
+                          read32(data.data(), StringsSizeOffset);
+    if (read32(data.data(), KindsOffset) + nodes > data.size() ||
+        read32(data.data(), NamesOffset) + nodes * 4 > data.size() ||
+        read32(data.data(), ForwardOffsetsOffset) + (nodes + 1) * 4 > data.size() ||
+        read32(data.data(), ForwardTargetsOffset) + edges * 4 > data.size() ||
+        read32(data.data(), ReverseOffsetsOffset) + (nodes + 1) * 4 > data.size() ||
+        read32(data.data(), ReverseTargetsOffset) + edges * 4 > data.size() ||
+        stringsEnd > data.size()) {
+        ErrorMessage = (Path + " is truncated").str();
+        return nullptr;
+    }
+
+    // Names are read as C strings, the pool must end in a NUL.
+    auto stringsSize = read32(data.data(), StringsSizeOffset);
+    if ((stringsSize && data[stringsEnd - 1] != 0) ||
+        !areRowsValid(data.data(), ForwardOffsetsOffset, ForwardTargetsOffset, nodes, edges) ||
+        !areRowsValid(data.data(), ReverseOffsetsOffset, ReverseTargetsOffset, nodes, edges)) {
+        ErrorMessage = (Path + " is corrupt").str();
+        return nullptr;
+    }
+
+    return std::unique_ptr<Graph>(new Graph(std::move(*buffer)));
+}
+
+uint32_t Graph::header(uint32_t Offset) const {
+    return read32(Buffer->getBufferStart(), Offset);
+}
+
+uint32_t Graph::size() const {
+    return header(NodeCountOffset);
+}
+
+StringRef Graph::getName(uint32_t Node) const {
+    auto *data = Buffer->getBufferStart();
+    return readString(StringRef(data + header(StringsOffset), header(StringsSizeOffset)),
+                      read32(data, header(NamesOffset) + Node * 4));
+}
+
+NodeKind Graph::getKind(uint32_t Node) const {
+    auto kind = static_cast<uint8_t>(Buffer->getBufferStart()[header(KindsOffset) + Node]);
+    return static_cast<NodeKind>(kind & ~PublicFlag);
+}
+
+bool Graph::isPublic(uint32_t Node) const {
+    auto kind = static_cast<uint8_t>(Buffer->getBufferStart()[header(KindsOffset) + Node]);
+    return kind & PublicFlag;
+}
+
+std::vector<uint32_t> Graph::findNodes(StringRef Name) const {
+    uint32_t low = 0;
+    uint32_t high = size();
+    while (low < high) {
+        auto middle = low + (high - low) / 2;
+        if (getName(middle) < Name) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    std::vector<uint32_t> found;
+    for (; low < size() && getName(low) == Name; ++low) {
+        found.push_back(low);
+    }
+    return found;
+}
+
+std::vector<uint32_t> Graph::reach(ArrayRef<uint32_t> Roots, bool Reverse, unsigned Jobs) const {
+    auto *data = Buffer->getBufferStart();
+    const auto offsets = header(Reverse ? ReverseOffsetsOffset : ForwardOffsetsOffset);
+    const auto targets = header(Reverse ? ReverseTargetsOffset : ForwardTargetsOffset);
+
+    // One bit per node, claimed with an atomic or so that two threads
+    // reaching a node in the same level only queue it once.
+    std::vector<std::atomic<uint64_t>> visited((size() + 63) / 64);
+    auto claim = [&](uint32_t Node) {
+        auto bit = uint64_t(1) << (Node % 64);
+        return !(visited[Node / 64].fetch_or(bit, std::memory_order_relaxed) & bit);
+    };
+
+    auto expand = [&](ArrayRef<uint32_t> Level, std::vector<uint32_t> &Next) {
+        for (auto node : Level) {
+            auto end = read32(data, offsets + (node + 1) * 4);
+            for (auto edge = read32(data, offsets + node * 4); edge < end; ++edge) {
+                auto target = read32(data, targets + edge * 4);
+                if (claim(target)) { Next.push_back(target); }
+            }
+        }
+    };
+
+    std::vector<uint32_t> found;
+    std::vector<uint32_t> level;
+    for (auto root : Roots) {
+        if (claim(root)) { level.push_back(root); }
+    }
+
+    std::unique_ptr<ThreadPool> pool;
+    while (!level.empty()) {
+        found.insert(found.end(), level.begin(), level.end());
+
+        std::vector<uint32_t> next;
+        if (Jobs <= 1 || level.size() < ParallelLevelSize) {
+            expand(level, next);
+        } else {
+            if (!pool) { pool = llvm::make_unique<ThreadPool>(Jobs); }
+
+            auto chunkSize = (level.size() + Jobs - 1) / Jobs;
+            std::vector<std::vector<uint32_t>> chunks(Jobs);
+            for (unsigned job = 0; job < Jobs; ++job) {
+                auto begin = std::min(level.size(), job * chunkSize);
+                auto chunk = ArrayRef<uint32_t>(level).slice(
+                    begin, std::min(chunkSize, level.size() - begin));
+                pool->async([&expand, chunk, &chunks, job] { expand(chunk, chunks[job]); });
+            }
+            pool->wait();
+
+            for (const auto &chunk : chunks) {
+                next.insert(next.end(), chunk.begin(), chunk.end());
+            }
+        }
+        level.swap(next);
+    }
+
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+std::vector<uint32_t> Graph::getExposingMethods(ArrayRef<uint32_t> Types, unsigned Jobs) const {
+    std::vector<uint32_t> methods;
+    for (auto node : reach(Types, /*Reverse=*/true, Jobs)) {
+        if (getKind(node) == Method && isPublic(node)) { methods.push_back(node); }
+    }
+    return methods;
+}
+
+}
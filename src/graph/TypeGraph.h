@@ -0,0 +1,82 @@
+#pragma once
+
+#include "support/BinaryFile.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+// What the declarations of an API depend on: a class points at its
+// methods, a method at its return and parameter types, a typedef at the
+// type it names, so reachability answers questions such as which public
+// methods expose a type.
+//
+// Edges are stored in compressed sparse row form, once in each direction:
+// the edges of node N are targets[offsets[N]] up to targets[offsets[N + 1]].
+//
+// Layout, little endian:
+//   header    magic "CTGRAPH\0", version (u32), node count (u32), edge count
+//             (u32), then the offsets of the kinds, names, forward offsets,
+//             forward targets, reverse offsets and reverse targets sections
+//             (u32 each) and the strings offset and size (u32 each)
+//   kinds     NodeKind (u8) per node, with PublicFlag set on public methods
+//   names     string offset (u32) per node, nodes sorted by name
+//   offsets   node count + 1 edge numbers (u32)
+//   targets   node numbers (u32)
+//   strings   NUL terminated
+namespace typegraph {
+
+enum NodeKind : uint8_t { Class, Method, Typedef, Type };
+constexpr uint8_t PublicFlag = 0x80;
+
+class Builder {
+    llvm::StringMap<uint32_t> Numbers;
+    std::vector<std::pair<std::string, uint8_t>> Nodes;
+    std::vector<std::pair<uint32_t, uint32_t>> Edges;
+
+public:
+    // The node of that kind and name, added on first use.
+    uint32_t addNode(NodeKind Kind, llvm::StringRef Name, bool IsPublic = false);
+    void addEdge(uint32_t From, uint32_t To) { Edges.emplace_back(From, To); }
+
+    std::error_code write(llvm::StringRef Path) const;
+};
+
+class Graph {
+    std::unique_ptr<llvm::MemoryBuffer> Buffer;
+
+    explicit Graph(std::unique_ptr<llvm::MemoryBuffer> Buffer) : Buffer(std::move(Buffer)) {}
+
+    uint32_t header(uint32_t Offset) const;
+
+public:
+    static std::unique_ptr<Graph> load(llvm::StringRef Path, std::string &ErrorMessage);
+
+    uint32_t size() const;
+    llvm::StringRef getName(uint32_t Node) const;
+    NodeKind getKind(uint32_t Node) const;
+    bool isPublic(uint32_t Node) const;
+
+    // Nodes of any kind with this name.
+    std::vector<uint32_t> findNodes(llvm::StringRef Name) const;
+
+    // Nodes reachable from Roots, Roots included, in increasing order. Walks
+    // edges backwards when Reverse. The search goes a level at a time and
+    // splits large levels across Jobs threads.
+    std::vector<uint32_t> reach(llvm::ArrayRef<uint32_t> Roots, bool Reverse,
+                                unsigned Jobs) const;
+
+    // Public methods the types are reachable from: taken or returned through
+    // any chain of typedefs, pointers and references, or through a class
+    // whose own methods expose them.
+    std::vector<uint32_t> getExposingMethods(llvm::ArrayRef<uint32_t> Types, unsigned Jobs) const;
+};
+
+}
@@ -0,0 +1,338 @@
+#include "HeaderMap.h"
+
+#include "support/BinaryFile.h"
+
+#include "clang/Basic/CharInfo.h"
+#include "clang/Lex/HeaderMapTypes.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+// Headers nested deeper than this are left to the -I search. This also stops
+// symbolic link cycles.
+constexpr int MaxDepth = 16;
+
+static bool isHeader(StringRef Path) {
+    return StringSwitch<bool>(sys::path::extension(Path).lower())
+        .Cases(".h", ".hh", ".hpp", ".hxx", true)
+        .Cases(".inc", ".inl", ".ipp", ".def", ".tcc", true)
+        .Default(false);
+}
+
+static std::string getDirectoryTimesPath(StringRef MapPath) { return (MapPath + ".dirs").str(); }
+
+// Zero for a directory that does not exist.
+static uint64_t getModificationSeconds(StringRef Directory) {
+    sys::fs::file_status status;
+    if (sys::fs::status(Directory, status) || !sys::fs::is_directory(status)) { return 0; }
+    return static_cast<uint64_t>(sys::toTimeT(status.getLastModificationTime()));
+}
+
+// Must match HeaderMapImpl's hash in clang/lib/Lex/HeaderMap.cpp.
+static uint32_t getHeaderMapHash(StringRef Key) {
+    uint32_t hash = 0;
+    for (auto c : Key) {
+        hash += toLowercase(c) * 13;
+    }
+    return hash;
+}
+
+std::vector<std::string> getIncludeDirectories(const CompileCommand &Command) {
+    std::vector<std::string> directories;
+    const auto &args = Command.CommandLine;
+    for (size_t i = 0; i < args.size(); ++i) {
+        StringRef arg = args[i];
+        if (!arg.consume_front("-I")) { continue; }
+        if (arg.empty()) {
+            if (++i == args.size()) { break; }
+            arg = args[i];
+        }
+
+        SmallString<256> path(arg);
+        if (sys::path::is_relative(path)) {
+            path = Command.Directory;
+            sys::path::append(path, arg);
+        }
+        sys::path::remove_dots(path, true);
+        directories.emplace_back(path.str());
+    }
+    return directories;
+}
+
+std::string getHeaderMapPath(StringRef Directory, ArrayRef<std::string> IncludeDirectories) {
+    MD5 hash;
+    for (const auto &directory : IncludeDirectories) {
+        hash.update(directory);
+        hash.update(StringRef("", 1));
+    }
+    MD5::MD5Result result;
+    hash.final(result);
+
+    SmallString<32> key;
+    MD5::stringifyResult(result, key);
+
+    SmallString<256> path(Directory);
+    sys::path::append(path, key + ".hmap");
+    return std::string(path.str());
+}
+
+// Mentions in comments and unreadable headers count too, a map is only a
+// shortcut.
+static bool usesIncludeNext(StringRef Path) {
+    auto buffer = MemoryBuffer::getFile(Path, -1, /*RequiresNullTerminator=*/false);
+    return !buffer || (*buffer)->getBuffer().find("include_next") != StringRef::npos;
+}
+
+std::error_code writeHeaderMap(StringRef Path, ArrayRef<std::string> IncludeDirectories,
+                               std::string &IncludeNextHeader) {
+    // Spelling to the directory it is found in, first directory wins.
+    StringMap<size_t> found;
+    // Lower case spelling to the first spelling seen with it.
+    StringMap<std::string> folded;
+    StringSet<> ambiguous;
+    // Every directory read, including -I directories that do not exist.
+    std::vector<std::string> scanned;
+    auto scanTime = static_cast<uint64_t>(sys::toTimeT(std::chrono::system_clock::now()));
+
+    for (size_t number = 0; number < IncludeDirectories.size(); ++number) {
+        StringRef directory = IncludeDirectories[number];
+        scanned.push_back(directory);
+        std::error_code ec;
+        for (sys::fs::recursive_directory_iterator it(directory, ec), end; it != end && !ec;
+             it.increment(ec)) {
+            if (it.level() >= MaxDepth) {
+                it.no_push();
+                continue;
+            }
+            if (sys::fs::is_directory(it->path())) {
+                scanned.push_back(it->path());
+                continue;
+            }
+            if (!isHeader(it->path())) { continue; }
+            if (usesIncludeNext(it->path())) {
+                IncludeNextHeader = it->path();
+                sys::fs::remove(getDirectoryTimesPath(Path));
+                sys::fs::remove(Path);
+                return std::make_error_code(std::errc::operation_not_supported);
+            }
+
+            StringRef relative = StringRef(it->path()).drop_front(directory.size()).ltrim("/\\");
+            std::string key(relative);
+            if (sys::path::is_separator('\\')) {
+                std::replace(key.begin(), key.end(), '\\', '/');
+            }
+            auto lower = StringRef(key).lower();
+
+            auto first = folded.insert(std::make_pair(lower, key));
+            if (!first.second && first.first->getValue() != key) {
+                ambiguous.insert(lower);
+                continue;
+            }
+            found.insert(std::make_pair(key, number));
+        }
+    }
+
+    std::vector<std::pair<std::string, size_t>> entries;
+    for (const auto &entry : found) {
+        if (!ambiguous.count(entry.getKey().lower())) {
+            entries.emplace_back(entry.getKey(), entry.getValue());
+        }
+    }
+
+    uint32_t bucketCount = NextPowerOf2(entries.size() * 2);
+    std::vector<HMapBucket> buckets(bucketCount, HMapBucket{ HMAP_EmptyBucketKey, 0, 0 });
+
+    StringPoolBuilder strings;
+    // Offset zero marks an empty bucket, so no key may start there.
+    strings.add("");
+
+    uint32_t maxValueLength = 0;
+    for (const auto &entry : entries) {
+        SmallString<256> prefix(IncludeDirectories[entry.second]);
+        prefix += '/';
+
+        HMapBucket bucket;
+        bucket.Key = strings.add(entry.first);
+        bucket.Prefix = strings.add(prefix);
+        bucket.Suffix = strings.add(entry.first);
+        maxValueLength = std::max<uint32_t>(maxValueLength, prefix.size() + entry.first.size());
+
+        for (auto slot = getHeaderMapHash(entry.first);; ++slot) {
+            auto &target = buckets[slot & (bucketCount - 1)];
+            if (target.Key == HMAP_EmptyBucketKey) {
+                target = bucket;
+                break;
+            }
+        }
+    }
+
+    BinaryWriter file;
+    file.write32(HMAP_HeaderMagicNumber);
+    file.write8(HMAP_HeaderVersion & 0xFF);
+    file.write8(HMAP_HeaderVersion >> 8);
+    file.write8(0);
+    file.write8(0);
+    file.write32(sizeof(HMapHeader) + bucketCount * sizeof(HMapBucket));
+    file.write32(entries.size());
+    file.write32(bucketCount);
+    file.write32(maxValueLength);
+    for (const auto &bucket : buckets) {
+        file.write32(bucket.Key);
+        file.write32(bucket.Prefix);
+        file.write32(bucket.Suffix);
+    }
+    file.writeBytes(strings.data());
+
+    if (auto ec = writeFileAtomically(Path, file.data())) { return ec; }
+
+    // The time the scan started, then one "<time>\t<directory>" line per
+    // directory. A list that fails to write leaves the map unused.
+    std::string times;
+    raw_string_ostream stream(times);
+    stream << scanTime << "\n";
+    for (const auto &directory : scanned) {
+        stream << getModificationSeconds(directory) << "\t" << directory << "\n";
+    }
+    auto timesPath = getDirectoryTimesPath(Path);
+    auto ec = writeFileAtomically(timesPath, stream.str());
+    if (ec) { sys::fs::remove(timesPath); }
+    return ec;
+}
+
+// Times have whole second resolution, so a directory last modified in the
+// second the scan started or later may have changed after it was read, and
+// its map is never trusted.
+bool isHeaderMapCurrent(StringRef Path) {
+    if (!sys::fs::is_regular_file(Path)) { return false; }
+
+    auto buffer = MemoryBuffer::getFile(getDirectoryTimesPath(Path));
+    if (!buffer) { return false; }
+
+    SmallVector<StringRef, 64> lines;
+    (*buffer)->getBuffer().split(lines, '\n', -1, false);
+    uint64_t scanTime;
+    if (lines.empty() || lines.front().getAsInteger(10, scanTime)) { return false; }
+
+    for (auto line : makeArrayRef(lines).drop_front()) {
+        StringRef time, directory;
+        std::tie(time, directory) = line.split('\t');
+        uint64_t recorded;
+        if (time.getAsInteger(10, recorded) || recorded >= scanTime ||
+            getModificationSeconds(directory) != recorded) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HeaderMapCompilationDatabase::isCurrent(StringRef Path) const {
+    std::lock_guard<std::mutex> lock(Mutex);
+    auto checked = Current.insert(std::make_pair(Path, false));
+    if (checked.second) { checked.first->second = isHeaderMapCurrent(Path); }
+    return checked.first->second;
+}
+
+std::vector<CompileCommand>
+HeaderMapCompilationDatabase::adjust(std::vector<CompileCommand> Commands) const {
+    for (auto &command : Commands) {
+        auto directories = getIncludeDirectories(command);
+        if (directories.empty()) { continue; }
+
+        auto path = getHeaderMapPath(Directory, directories);
+        if (!isCurrent(path)) { continue; }
+
+        auto &args = command.CommandLine;
+        auto first = std::find_if(args.begin(), args.end(), [](const std::string &Arg) {
+            return StringRef(Arg).startswith("-I");
+        });
+        args.insert(first, "-I" + path);
+    }
+    return Commands;
+}
+
+std::vector<CompileCommand>
+HeaderMapCompilationDatabase::getCompileCommands(StringRef FilePath) const {
+    return adjust(Base.getCompileCommands(FilePath));
+}
+
+std::vector<std::string> HeaderMapCompilationDatabase::getAllFiles() const {
+    return Base.getAllFiles();
+}
+
+std::vector<CompileCommand> HeaderMapCompilationDatabase::getAllCompileCommands() const {
+    return adjust(Base.getAllCompileCommands());
+}
+
+int runHeaderMapCommand(int argc, const char **argv) {
+    std::string outputDirectory;
+    std::string buildPath;
+
+    for (int i = 1; i < argc; ++i) {
+        StringRef arg(argv[i]);
+        if (arg.consume_front("--headermap-dir=")) {
+            outputDirectory = arg;
+        } else if (arg.consume_front("--build-path=")) {
+            buildPath = arg;
+        } else {
+            errs() << "error: unknown headermap option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (outputDirectory.empty() || buildPath.empty()) {
+        errs() << "error: headermap requires --headermap-dir=<directory> and "
+                  "--build-path=<directory>\n";
+        return 1;
+    }
+
+    std::string errorMessage;
+    auto compilations = CompilationDatabase::autoDetectFromDirectory(buildPath, errorMessage);
+    if (!compilations) {
+        errs() << "error: " << errorMessage << "\n";
+        return 1;
+    }
+
+    if (auto ec = sys::fs::create_directories(outputDirectory)) {
+        errs() << "error: cannot create " << outputDirectory << ": " << ec.message() << "\n";
+        return 1;
+    }
+
+    StringSet<> written;
+    auto ret = 0;
+    for (const auto &command : compilations->getAllCompileCommands()) {
+        auto directories = getIncludeDirectories(command);
+        if (directories.empty()) { continue; }
+
+        auto path = getHeaderMapPath(outputDirectory, directories);
+        if (!written.insert(path).second) { continue; }
+
+        std::string includeNextHeader;
+        auto ec = writeHeaderMap(path, directories, includeNextHeader);
+        if (ec == std::errc::operation_not_supported) {
+            outs() << path << "\tskipped, " << includeNextHeader << " uses #include_next\n";
+            continue;
+        }
+        if (ec) {
+            errs() << "error: cannot write " << path << ": " << ec.message() << "\n";
+            ret = 1;
+            continue;
+        }
+        outs() << path << "\t" << directories.size() << " directories\n";
+    }
+    return ret;
+}
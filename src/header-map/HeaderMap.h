@@ -0,0 +1,82 @@
+#pragma once
+
+#include "clang/Tooling/CompilationDatabase.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// Clang header maps (.hmap, see clang/Lex/HeaderMap.h) standing in for long
+// -I lists. A map names, for every header under the listed directories,
+// the file the search would find first, so an include costs one hash
+// lookup instead of a failed stat per directory before the right one.
+//
+// Maps live in one directory, named after a hash of the absolute -I list
+// they stand for. Only headers (.h, .hh, .hpp, .hxx, .inc, .inl, .ipp,
+// .def, .tcc) are mapped; anything else falls through to the -I search, as
+// does a spelling that differs from another header only by case, since
+// header map lookups ignore case.
+//
+// A file reached through a map continues #include_next from the map, so no
+// map is written for an -I list if any of its headers mentions
+// include_next.
+//
+// Next to each map, <map>.dirs lists the modification time of every
+// directory the map was built from. Adding, removing or renaming a header
+// changes its directory's time, and a map whose directories changed is not
+// used until the headermap subcommand writes it again.
+
+// The -I directories of Command in search order, made absolute.
+std::vector<std::string> getIncludeDirectories(const clang::tooling::CompileCommand &Command);
+
+// Where the map for IncludeDirectories is kept under Directory.
+std::string getHeaderMapPath(llvm::StringRef Directory,
+                             llvm::ArrayRef<std::string> IncludeDirectories);
+
+// Writes the map and its list of directory times. Fails with
+// errc::operation_not_supported, naming the header in IncludeNextHeader and
+// removing any earlier map, if a header uses #include_next.
+std::error_code writeHeaderMap(llvm::StringRef Path,
+                               llvm::ArrayRef<std::string> IncludeDirectories,
+                               std::string &IncludeNextHeader);
+
+// True if the map at Path exists and none of its directories changed since
+// it was written.
+bool isHeaderMapCurrent(llvm::StringRef Path);
+
+// Serves the commands of Base with -I<map> ahead of their first -I when a
+// current map for their -I list exists in Directory.
+class HeaderMapCompilationDatabase : public clang::tooling::CompilationDatabase {
+    const clang::tooling::CompilationDatabase &Base;
+    std::string Directory;
+    // isHeaderMapCurrent per map path, checked once for the database's
+    // lifetime since commands are asked for several times per unit.
+    mutable std::mutex Mutex;
+    mutable llvm::StringMap<bool> Current;
+
+    bool isCurrent(llvm::StringRef Path) const;
+
+    std::vector<clang::tooling::CompileCommand>
+    adjust(std::vector<clang::tooling::CompileCommand> Commands) const;
+
+public:
+    HeaderMapCompilationDatabase(const clang::tooling::CompilationDatabase &Base,
+                                 llvm::StringRef Directory)
+        : Base(Base), Directory(Directory) {}
+
+    std::vector<clang::tooling::CompileCommand>
+    getCompileCommands(llvm::StringRef FilePath) const override;
+
+    std::vector<std::string> getAllFiles() const override;
+
+    std::vector<clang::tooling::CompileCommand> getAllCompileCommands() const override;
+};
+
+// The "headermap" subcommand: writes a map into --headermap-dir for every
+// distinct -I list in the compilation database under --build-path.
+int runHeaderMapCommand(int argc, const char **argv);
@@ -0,0 +1,466 @@
+#include "SymbolIndex.h"
+
+#include "arguments/AnalysisArguments.h"
+#include "file-cache/SharedFileCache.h"
+#include "support/BinaryFile.h"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Index/IndexDataConsumer.h"
+#include "clang/Index/IndexingAction.h"
+#include "clang/Index/USRGeneration.h"
+#include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/Tooling.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+#include <algorithm>
+#include <set>
+
+using namespace clang;
+using namespace clang::index;
+using namespace clang::tooling;
+using namespace llvm;
+
+static cl::OptionCategory IndexCategory("index options");
+
+static cl::opt<std::string> IndexFile(
+    "index-file", cl::desc("Symbol index to write, or to read for lookups"),
+    cl::value_desc("file"), cl::cat(IndexCategory));
+
+static cl::opt<std::string> MethodsOf(
+    "methods-of", cl::desc("Print the methods of this qualified class name"),
+    cl::value_desc("class"), cl::cat(IndexCategory));
+
+namespace {
+
+constexpr char Magic[] = { 'C', 'T', 'I', 'N', 'D', 'E', 'X', 0 };
+constexpr uint32_t Version = 1;
+
+enum : uint32_t {
+    VersionOffset = 8,
+    SymbolCountOffset = 12,
+    SymbolsOffset = 16,
+    NameOrderOffset = 20,
+    RelationCountOffset = 24,
+    RelationsOffset = 28,
+    StringsOffset = 32,
+    StringsSizeOffset = 36,
+    HeaderSize = 40
+};
+
+constexpr uint32_t SymbolSize = 36;
+constexpr uint32_t RelationSize = 8;
+constexpr uint32_t NoFile = 0xFFFFFFFF;
+
+struct CollectedLocation {
+    std::string File;
+    unsigned Line = 0;
+    unsigned Column = 0;
+};
+
+struct CollectedSymbol {
+    std::string QualifiedName;
+    SymbolKind Kind = SymbolKind::Unknown;
+    CollectedLocation Declaration;
+    CollectedLocation Definition;
+};
+
+bool isMethod(SymbolKind Kind) {
+    switch (Kind) {
+    case SymbolKind::InstanceMethod:
+    case SymbolKind::ClassMethod:
+    case SymbolKind::StaticMethod:
+    case SymbolKind::Constructor:
+    case SymbolKind::Destructor:
+    case SymbolKind::ConversionFunction:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool isClass(SymbolKind Kind) {
+    return Kind == SymbolKind::Class || Kind == SymbolKind::Struct || Kind == SymbolKind::Union;
+}
+
+// Gathers the declarations and definitions of every translation unit of a
+// run, keyed by USR so that a header's symbols are stored once.
+class SymbolCollector : public IndexDataConsumer {
+    ASTContext *Context = nullptr;
+    DenseMap<FileID, std::string> FileNames;
+
+    StringRef getFileName(FileID File) {
+        auto &name = FileNames[File];
+        if (name.empty()) {
+            const auto *entry = Context->getSourceManager().getFileEntryForID(File);
+            SmallString<256> path(entry ? entry->getName() : "");
+            sys::fs::make_absolute(path);
+            sys::path::remove_dots(path, true);
+            name = path.str();
+        }
+        return name;
+    }
+
+    CollectedLocation getLocation(FileID File, unsigned Offset) {
+        const auto &sourceManager = Context->getSourceManager();
+        CollectedLocation location;
+        location.File = getFileName(File);
+        location.Line = sourceManager.getLineNumber(File, Offset);
+        location.Column = sourceManager.getColumnNumber(File, Offset);
+        return location;
+    }
+
+    static bool getUSR(const Decl *D, std::string &USR) {
+        SmallString<128> buffer;
+        if (generateUSRForDecl(D, buffer)) { return false; }
+        USR = buffer.str();
+        return true;
+    }
+
+public:
+    StringMap<CollectedSymbol> Symbols;
+    // Class and method USRs.
+    std::set<std::pair<std::string, std::string>> Methods;
+
+    void initialize(ASTContext &Ctx) override {
+        Context = &Ctx;
+        FileNames.clear();
+    }
+
+    bool handleDeclOccurence(const Decl *D, SymbolRoleSet Roles,
+                             ArrayRef<SymbolRelation> Relations, FileID FID, unsigned Offset,
+                             ASTNodeInfo ASTNode) override {
+        auto declaration = static_cast<SymbolRoleSet>(SymbolRole::Declaration);
+        auto definition = static_cast<SymbolRoleSet>(SymbolRole::Definition);
+        if (!(Roles & (declaration | definition)) ||
+            (Roles & static_cast<SymbolRoleSet>(SymbolRole::Implicit)) || FID.isInvalid()) {
+            return true;
+        }
+
+        std::string usr;
+        if (!getUSR(D, usr)) { return true; }
+
+        auto &symbol = Symbols[usr];
+        if (symbol.QualifiedName.empty()) {
+            if (const auto *named = dyn_cast<NamedDecl>(D)) {
+                symbol.QualifiedName = named->getQualifiedNameAsString();
+            }
+            symbol.Kind = getSymbolInfo(D).Kind;
+        }
+
+        // Prefer a declaration that is not also the definition.
+        auto location = getLocation(FID, Offset);
+        if (Roles & definition) {
+            if (!symbol.Definition.Line) { symbol.Definition = location; }
+            if (!symbol.Declaration.Line) { symbol.Declaration = location; }
+        } else if (!symbol.Declaration.Line || (symbol.Declaration.Line == symbol.Definition.Line &&
+                                                symbol.Declaration.File == symbol.Definition.File)) {
+            symbol.Declaration = location;
+        }
+
+        if (!isMethod(symbol.Kind)) { return true; }
+
+        for (const auto &relation : Relations) {
+            if (!(relation.Roles & static_cast<SymbolRoleSet>(SymbolRole::RelationChildOf)) ||
+                !isClass(getSymbolInfo(relation.RelatedSymbol).Kind)) {
+                continue;
+            }
+            std::string classUSR;
+            if (getUSR(relation.RelatedSymbol, classUSR)) {
+                Methods.emplace(std::move(classUSR), usr);
+            }
+        }
+        return true;
+    }
+};
+
+class IndexActionFactory : public FrontendActionFactory {
+    std::shared_ptr<SymbolCollector> Collector;
+
+public:
+    explicit IndexActionFactory(std::shared_ptr<SymbolCollector> Collector)
+        : Collector(std::move(Collector)) {}
+
+    FrontendAction *create() override {
+        IndexingOptions options;
+        options.SystemSymbolFilter = IndexingOptions::SystemSymbolFilterKind::DeclarationsOnly;
+        return createIndexingAction(Collector, options, nullptr).release();
+    }
+};
+
+} // namespace
+
+static std::error_code writeIndex(StringRef Path, const SymbolCollector &Collector) {
+    std::vector<StringRef> usrs;
+    for (const auto &symbol : Collector.Symbols) {
+        usrs.push_back(symbol.getKey());
+    }
+    std::sort(usrs.begin(), usrs.end());
+
+    StringMap<uint32_t> numbers;
+    for (uint32_t i = 0; i < usrs.size(); ++i) {
+        numbers[usrs[i]] = i;
+    }
+
+    StringPoolBuilder strings;
+    BinaryWriter symbols;
+    std::vector<std::pair<StringRef, uint32_t>> names;
+
+    auto writeLocation = [&](const CollectedLocation &Location) {
+        symbols.write32(Location.Line ? strings.add(Location.File) : NoFile);
+        symbols.write32(Location.Line);
+        symbols.write32(Location.Column);
+    };
+
+    for (uint32_t i = 0; i < usrs.size(); ++i) {
+        const auto &symbol = Collector.Symbols.find(usrs[i])->second;
+        symbols.write32(strings.add(usrs[i]));
+        symbols.write32(strings.add(symbol.QualifiedName));
+        symbols.write32(static_cast<uint32_t>(symbol.Kind));
+        writeLocation(symbol.Declaration);
+        writeLocation(symbol.Definition);
+        names.emplace_back(symbol.QualifiedName, i);
+    }
+    std::sort(names.begin(), names.end());
+
+    std::vector<std::pair<uint32_t, uint32_t>> relations;
+    for (const auto &method : Collector.Methods) {
+        auto parent = numbers.find(method.first);
+        auto child = numbers.find(method.second);
+        if (parent != numbers.end() && child != numbers.end()) {
+            relations.emplace_back(parent->second, child->second);
+        }
+    }
+    std::sort(relations.begin(), relations.end());
+
+    BinaryWriter file;
+    file.writeBytes(StringRef(Magic, sizeof(Magic)));
+    while (file.size() < HeaderSize) {
+        file.write32(0);
+    }
+    file.patch32(VersionOffset, Version);
+    file.patch32(SymbolCountOffset, usrs.size());
+
+    file.patch32(SymbolsOffset, file.size());
+    file.writeBytes(symbols.data());
+
+    file.patch32(NameOrderOffset, file.size());
+    for (const auto &name : names) {
+        file.write32(name.second);
+    }
+
+    file.patch32(RelationCountOffset, relations.size());
+    file.patch32(RelationsOffset, file.size());
+    for (const auto &relation : relations) {
+        file.write32(relation.first);
+        file.write32(relation.second);
+    }
+
+    file.patch32(StringsOffset, file.size());
+    file.patch32(StringsSizeOffset, strings.data().size());
+    file.writeBytes(strings.data());
+
+    return writeFileAtomically(Path, file.data());
+}
+
+std::unique_ptr<SymbolIndex> SymbolIndex::load(StringRef Path, std::string &ErrorMessage) {
+    auto buffer = MemoryBuffer::getFile(Path, -1, /*RequiresNullTerminator=*/false);
+    if (!buffer) {
+        ErrorMessage = ("cannot read " + Path + ": " + buffer.getError().message()).str();
+        return nullptr;
+    }
+
+    auto data = (*buffer)->getBuffer();
+    if (data.size() < HeaderSize || !data.startswith(StringRef(Magic, sizeof(Magic))) ||
+        read32(data.data(), VersionOffset) != Version) {
+        ErrorMessage = (Path + " is not an index written by this version").str();
+        return nullptr;
+    }
+
+    uint64_t symbolCount = read32(data.data(), SymbolCountOffset);
+    uint64_t symbolsEnd = read32(data.data(), SymbolsOffset) + symbolCount * SymbolSize;
+    uint64_t namesEnd = read32(data.data(), NameOrderOffset) + symbolCount * 4;
+    uint64_t relationsEnd = read32(data.data(), RelationsOffset) +
+                            uint64_t(read32(data.data(), RelationCountOffset)) * RelationSize;
+    uint64_t stringsEnd = uint64_t(read32(data.data(), StringsOffset)) +
+                          read32(data.data(), StringsSizeOffset);
+    if (symbolsEnd > data.size() || namesEnd > data.size() || relationsEnd > data.size() ||
+        stringsEnd > data.size()) {
+        ErrorMessage = (Path + " is truncated").str();
+        return nullptr;
+    }
+
+    // Strings are read as C strings, the pool must end in a NUL. Offsets and
+    // symbol numbers inside the sections are checked as they are read.
+    if (read32(data.data(), StringsSizeOffset) && data[stringsEnd - 1] != 0) {
+        ErrorMessage = (Path + " is corrupt").str();
+        return nullptr;
+    }
+
+    return std::unique_ptr<SymbolIndex>(new SymbolIndex(std::move(*buffer)));
+}
+
+uint32_t SymbolIndex::size() const {
+    return read32(Buffer->getBufferStart(), SymbolCountOffset);
+}
+
+SymbolIndex::Symbol SymbolIndex::getSymbol(uint32_t Number) const {
+    if (Number >= size()) { return Symbol(); }
+
+    auto *data = Buffer->getBufferStart();
+    auto strings = StringRef(data + read32(data, StringsOffset), read32(data, StringsSizeOffset));
+    auto entry = read32(data, SymbolsOffset) + Number * SymbolSize;
+
+    auto readLocation = [&](uint32_t Offset) {
+        Location location;
+        auto file = read32(data, entry + Offset);
+        if (file != NoFile) {
+            // readString gives an empty name for an offset outside the pool.
+            location.File = readString(strings, file);
+            location.Line = read32(data, entry + Offset + 4);
+            location.Column = read32(data, entry + Offset + 8);
+        }
+        return location;
+    };
+
+    Symbol symbol;
+    symbol.USR = readString(strings, read32(data, entry));
+    symbol.QualifiedName = readString(strings, read32(data, entry + 4));
+    symbol.Kind = static_cast<SymbolKind>(read32(data, entry + 8));
+    symbol.Declaration = readLocation(12);
+    symbol.Definition = readLocation(24);
+    return symbol;
+}
+
+uint32_t SymbolIndex::findUSR(StringRef USR) const {
+    auto *data = Buffer->getBufferStart();
+    auto strings = StringRef(data + read32(data, StringsOffset), read32(data, StringsSizeOffset));
+    auto symbols = read32(data, SymbolsOffset);
+
+    uint32_t low = 0;
+    uint32_t high = size();
+    while (low < high) {
+        auto middle = low + (high - low) / 2;
+        auto compare = readString(strings, read32(data, symbols + middle * SymbolSize)).compare(USR);
+        if (compare == 0) { return middle; }
+        if (compare < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return NotFound;
+}
+
+std::vector<uint32_t> SymbolIndex::findQualifiedName(StringRef QualifiedName) const {
+    auto *data = Buffer->getBufferStart();
+    auto strings = StringRef(data + read32(data, StringsOffset), read32(data, StringsSizeOffset));
+    auto symbols = read32(data, SymbolsOffset);
+    auto names = read32(data, NameOrderOffset);
+
+    auto nameAt = [&](uint32_t Position) {
+        auto number = read32(data, names + Position * 4);
+        if (number >= size()) { return StringRef(); }
+        return readString(strings, read32(data, symbols + number * SymbolSize + 4));
+    };
+
+    uint32_t low = 0;
+    uint32_t high = size();
+    while (low < high) {
+        auto middle = low + (high - low) / 2;
+        if (nameAt(middle) < QualifiedName) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    std::vector<uint32_t> found;
+    for (; low < size() && nameAt(low) == QualifiedName; ++low) {
+        found.push_back(read32(data, names + low * 4));
+    }
+    return found;
+}
+
+std::vector<uint32_t> SymbolIndex::getMethods(uint32_t Class) const {
+    auto *data = Buffer->getBufferStart();
+    auto relations = read32(data, RelationsOffset);
+    auto count = read32(data, RelationCountOffset);
+
+    uint32_t low = 0;
+    uint32_t high = count;
+    while (low < high) {
+        auto middle = low + (high - low) / 2;
+        if (read32(data, relations + middle * RelationSize) < Class) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    std::vector<uint32_t> methods;
+    for (; low < count && read32(data, relations + low * RelationSize) == Class; ++low) {
+        auto method = read32(data, relations + low * RelationSize + 4);
+        if (method < size()) { methods.push_back(method); }
+    }
+    return methods;
+}
+
+static int printMethods(StringRef Path, StringRef ClassName) {
+    std::string errorMessage;
+    auto index = SymbolIndex::load(Path, errorMessage);
+    if (!index) {
+        errs() << "error: " << errorMessage << "\n";
+        return 1;
+    }
+
+    for (auto classNumber : index->findQualifiedName(ClassName)) {
+        if (!isClass(index->getSymbol(classNumber).Kind)) { continue; }
+
+        for (auto methodNumber : index->getMethods(classNumber)) {
+            auto method = index->getSymbol(methodNumber);
+            outs() << "method\t" << method.QualifiedName << "\t"
+                   << getSymbolKindString(method.Kind) << "\t" << method.Declaration.File << ":"
+                   << method.Declaration.Line << ":" << method.Declaration.Column << "\t"
+                   << method.USR << "\n";
+        }
+    }
+    return 0;
+}
+
+int runIndexCommand(int argc, const char **argv) {
+    CommonOptionsParser OptionsParser(argc, argv, IndexCategory, cl::ZeroOrMore);
+
+    if (IndexFile.empty()) {
+        errs() << "error: index requires --index-file=<file>\n";
+        return 1;
+    }
+
+    if (OptionsParser.getSourcePathList().empty()) {
+        if (MethodsOf.empty()) {
+            errs() << "error: index requires source paths to index or --methods-of=<class>\n";
+            return 1;
+        }
+        return printMethods(IndexFile, MethodsOf);
+    }
+
+    AnalysisCompilationDatabase compilations(OptionsParser.getCompilations());
+    ClangTool Tool(compilations, OptionsParser.getSourcePathList());
+    Tool.getFiles().addStatCache(llvm::make_unique<SharedStatCache>());
+
+    auto collector = std::make_shared<SymbolCollector>();
+    IndexActionFactory factory(collector);
+    auto ret = Tool.run(&factory);
+
+    if (auto ec = writeIndex(IndexFile, *collector)) {
+        errs() << "error: cannot write " << IndexFile << ": " << ec.message() << "\n";
+        return 1;
+    }
+
+    return ret;
+}
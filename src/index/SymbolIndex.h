@@ -0,0 +1,66 @@
+#pragma once
+
+#include "clang/Index/IndexSymbol.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// A symbol table built by the index subcommand, read in place from a mapped
+// file so that lookups cost a binary search and no parsing.
+//
+// Layout, little endian:
+//   header     magic "CTINDEX\0", version (u32), symbol count (u32), symbols
+//              offset (u32), name order offset (u32), relation count (u32),
+//              relations offset (u32), strings offset (u32), strings size (u32)
+//   symbols    {USR (u32), qualified name (u32), kind (u32), declaration file,
+//              line, column (u32 each), definition file, line, column (u32
+//              each)} sorted by USR. A symbol without a definition has the
+//              file set to 0xFFFFFFFF.
+//   name order symbol numbers (u32) sorted by qualified name
+//   relations  {class (u32), method (u32)} symbol numbers sorted by class
+//   strings    NUL terminated
+class SymbolIndex {
+    std::unique_ptr<llvm::MemoryBuffer> Buffer;
+
+    explicit SymbolIndex(std::unique_ptr<llvm::MemoryBuffer> Buffer)
+        : Buffer(std::move(Buffer)) {}
+
+public:
+    static constexpr uint32_t NotFound = 0xFFFFFFFF;
+
+    struct Location {
+        llvm::StringRef File;
+        uint32_t Line = 0;
+        uint32_t Column = 0;
+
+        bool isValid() const { return Line != 0; }
+    };
+
+    struct Symbol {
+        llvm::StringRef USR;
+        llvm::StringRef QualifiedName;
+        clang::index::SymbolKind Kind = clang::index::SymbolKind::Unknown;
+        Location Declaration;
+        Location Definition;
+    };
+
+    static std::unique_ptr<SymbolIndex> load(llvm::StringRef Path, std::string &ErrorMessage);
+
+    uint32_t size() const;
+    // Empty for a number that is not a symbol. Strings outside the pool of a
+    // corrupt index read as empty.
+    Symbol getSymbol(uint32_t Number) const;
+
+    // Symbol numbers, NotFound or empty when there is no such symbol.
+    uint32_t findUSR(llvm::StringRef USR) const;
+    std::vector<uint32_t> findQualifiedName(llvm::StringRef QualifiedName) const;
+    std::vector<uint32_t> getMethods(uint32_t Class) const;
+};
+
+// The "index" subcommand. With source paths it indexes them into the file
+// named by --index-file; without, it answers --methods-of=<class> from it.
+int runIndexCommand(int argc, const char **argv);
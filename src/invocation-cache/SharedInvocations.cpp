@@ -0,0 +1,122 @@
+#include "SharedInvocations.h"
+
+#include "arguments/AnalysisArguments.h"
+
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/PCHContainerOperations.h"
+#include "clang/Lex/PreprocessorOptions.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+static void changeDirectory(const std::string &Path) {
+#ifdef _WIN32
+    auto failed = ::_chdir(Path.c_str()) != 0;
+#else
+    auto failed = ::chdir(Path.c_str()) != 0;
+#endif
+    if (failed) {
+        report_fatal_error("Cannot chdir into \"" + Twine(Path) + "\"");
+    }
+}
+
+namespace {
+
+// Keeps a copy of the invocation the driver built before running it.
+class CapturingAction : public ToolAction {
+    ToolAction &Action;
+    std::shared_ptr<CompilerInvocation> &Captured;
+
+public:
+    CapturingAction(ToolAction &Action, std::shared_ptr<CompilerInvocation> &Captured)
+        : Action(Action), Captured(Captured) {}
+
+    bool runInvocation(std::shared_ptr<CompilerInvocation> Invocation, FileManager *Files,
+                       std::shared_ptr<PCHContainerOperations> PCHContainerOps,
+                       DiagnosticConsumer *DiagConsumer) override {
+        // Remapped buffers are owned by the unit that uses them.
+        if (Invocation->getPreprocessorOpts().RemappedFileBuffers.empty() &&
+            Invocation->getFrontendOpts().Inputs.size() == 1) {
+            Captured = std::make_shared<CompilerInvocation>(*Invocation);
+        }
+        return Action.runInvocation(std::move(Invocation), Files, std::move(PCHContainerOps),
+                                    DiagConsumer);
+    }
+};
+
+}
+
+int runWithSharedInvocations(FileManager &Files, const CompilationDatabase &Compilations,
+                             ArrayRef<std::string> SourcePaths, ToolAction &Action) {
+    static int StaticSymbol;
+    auto mainExecutable = sys::fs::getMainExecutable("clang_tool", &StaticSymbol);
+    auto adjuster = combineAdjusters(getClangStripOutputAdjuster(), getClangSyntaxOnlyAdjuster());
+    auto pchContainerOps = std::make_shared<PCHContainerOperations>();
+
+    SmallString<256> initialDirectory;
+    if (auto ec = sys::fs::current_path(initialDirectory)) {
+        errs() << "error: cannot get the working directory: " << ec.message() << "\n";
+        return 1;
+    }
+
+    StringMap<std::shared_ptr<CompilerInvocation>> invocations;
+    auto failed = false;
+
+    for (const auto &path : SourcePaths) {
+        auto file = getAbsolutePath(path);
+        auto commands = Compilations.getCompileCommands(file);
+        if (commands.empty()) {
+            errs() << "Skipping " << file << ". Compile command not found.\n";
+            continue;
+        }
+
+        for (const auto &command : commands) {
+            changeDirectory(command.Directory);
+
+            auto &shared = invocations[getCompileSettingsKey(command) + '\0' +
+                                       sys::path::extension(command.Filename).str()];
+            bool succeeded;
+            if (shared) {
+                auto invocation = std::make_shared<CompilerInvocation>(*shared);
+                auto &input = invocation->getFrontendOpts().Inputs.front();
+                input = FrontendInputFile(command.Filename, input.getKind(), input.isSystem());
+                invocation->getCodeGenOpts().MainFileName = sys::path::filename(command.Filename);
+
+                succeeded = Action.runInvocation(std::move(invocation), &Files, pchContainerOps,
+                                                 nullptr);
+            } else {
+                auto commandLine = adjuster(command.CommandLine, command.Filename);
+                commandLine[0] = mainExecutable;
+
+                CapturingAction capturing(Action, shared);
+                ToolInvocation invocation(std::move(commandLine), &capturing, &Files,
+                                          pchContainerOps);
+                succeeded = invocation.run();
+            }
+
+            if (!succeeded) {
+                errs() << "Error while processing " << file << ".\n";
+                failed = true;
+            }
+
+            // Relative source paths are relative to where the run started.
+            changeDirectory(initialDirectory.str());
+        }
+    }
+
+    return failed ? 1 : 0;
+}
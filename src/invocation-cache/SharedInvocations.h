@@ -0,0 +1,22 @@
+#pragma once
+
+#include "clang/Basic/FileManager.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include <string>
+
+// Runs Action over SourcePaths the way ClangTool::run does, except that the
+// driver runs once per distinct compile settings (getCompileSettingsKey and
+// the file's extension). The compiler invocation it builds is kept, and
+// later units with the same settings get a copy with only the input file
+// swapped, skipping the driver's argument parsing and toolchain probing.
+//
+// Every unit shares Files, so header search probes stay warm across units.
+// Units whose invocation remaps files are always built by the driver.
+int runWithSharedInvocations(clang::FileManager &Files,
+                             const clang::tooling::CompilationDatabase &Compilations,
+                             llvm::ArrayRef<std::string> SourcePaths,
+                             clang::tooling::ToolAction &Action);
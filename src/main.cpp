@@ -1,15 +1,40 @@
 // Declares clang::SyntaxOnlyAction.
 #include "clang/Frontend/FrontendActions.h"
+#include "clang/Frontend/Utils.h"
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
 
 // Declares llvm::cl::extrahelp.
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
 
 //For AST matching
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 
+#include "analyses/Analysis.h"
+#include "arguments/AnalysisArguments.h"
+#include "fast-exit/FastExit.h"
+#include "file-cache/SharedFileCache.h"
+#include "fork-server/ForkServer.h"
+#include "graph/GraphCommand.h"
+#include "header-map/HeaderMap.h"
+#include "index/SymbolIndex.h"
+#include "invocation-cache/SharedInvocations.h"
+#include "merged-ast/MergedAST.h"
+#include "plugin/SidecarMerge.h"
+#include "prefilter/LexicalPrefilter.h"
+#include "query/QueryCommand.h"
+#include "queries/QueryAnalysis.h"
+#include "queries/QueryCodegen.h"
+#include "result-cache/ResultCache.h"
+#include "results/ScanResults.h"
+#include "scope/TraversalScope.h"
+#include "support/HeapTuning.h"
+#include "tiered/SignatureExtractor.h"
+#include "vfs-pack/VfsPack.h"
+
 //#include <iostream>
 
 using namespace clang;
@@ -29,73 +54,571 @@ static cl::extrahelp CommonHelp(CommonOptionsParser::HelpMessage);
 // A help message for this specific tool can be added afterwards.
 static cl::extrahelp MoreHelp("\nMore help text...");
 
-constexpr auto classBindName = "class";
-auto ClassDeclMatcher = cxxRecordDecl(isDefinition()).bind(classBindName);
+static cl::opt<std::string> ForkServerSocket(
+    "fork-server",
+    cl::desc("Stay resident and serve runs over this UNIX socket, forking a\n"
+             "pre-initialized child per request"),
+    cl::value_desc("socket"), cl::cat(MyToolCategory));
+
+static cl::opt<std::string> ForkServerBuildPath(
+    "fork-server-build-path",
+    cl::desc("Directory holding the compilation database --fork-server\n"
+             "loads when no source paths are given"),
+    cl::value_desc("directory"), cl::cat(MyToolCategory));
+
+static cl::opt<bool> UseSharedFileCache(
+    "shared-file-cache",
+    cl::desc("Stat and read every file once per run, sharing the results\n"
+             "across translation units (default on)"),
+    cl::init(true), cl::cat(MyToolCategory));
+
+static cl::opt<bool> UseAnalysisArguments(
+    "analysis-args",
+    cl::desc("Strip optimisation, debug info and warning flags from compile\n"
+             "commands and skip commands made identical by it (default on)"),
+    cl::init(true), cl::cat(MyToolCategory));
+
+static cl::list<std::string> RequiredIdentifiers(
+    "require-identifier",
+    cl::desc("Skip translation units unless their source and the headers it\n"
+             "includes contain all of these identifiers"),
+    cl::CommaSeparated, cl::value_desc("name"), cl::cat(MyToolCategory));
+
+static cl::opt<bool> TieredParsing(
+    "tiered",
+    cl::desc("Read signatures of simple headers straight from their tokens,\n"
+             "falling back to a full parse for anything else"),
+    cl::cat(MyToolCategory));
+
+static cl::opt<std::string> VfsPackPath(
+    "vfs-pack",
+    cl::desc("Serve source files and headers from an archive written by the\n"
+             "pack subcommand instead of the file system"),
+    cl::value_desc("file"), cl::cat(MyToolCategory));
+
+static cl::list<std::string> AnalysisNames(
+    "analyses",
+    cl::desc("Analyses to run together in one parse: signatures, layouts,\n"
+             "enums (default signatures)"),
+    cl::CommaSeparated, cl::value_desc("name"), cl::cat(MyToolCategory));
+
+static cl::list<std::string> QueryFiles(
+    "query-file",
+    cl::desc("Also report nodes matching the matcher expressions in this\n"
+             "file, all queries sharing the analyses' traversal"),
+    cl::value_desc("file"), cl::cat(MyToolCategory));
+
+// Asking queries replaces the default analysis.
+static std::vector<std::string> getAnalysisNames() {
+    if (AnalysisNames.empty() && !QueryFiles.empty()) { return {}; }
+    if (AnalysisNames.empty()) { return { "signatures" }; }
+    return { AnalysisNames.begin(), AnalysisNames.end() };
+}
+
+static cl::list<std::string> ScopeNamespaces(
+    "scope-namespace",
+    cl::desc("Only match declarations inside these namespaces, e.g.\n"
+             "Eegeo::Api, skipping everything else without traversing it"),
+    cl::CommaSeparated, cl::value_desc("namespace"), cl::cat(MyToolCategory));
+
+static cl::list<std::string> ScopePaths(
+    "scope-path",
+    cl::desc("Only match declarations in files under these directories"),
+    cl::CommaSeparated, cl::value_desc("path"), cl::cat(MyToolCategory));
+
+static cl::opt<bool> SkipSystemHeaders(
+    "skip-system-headers",
+    cl::desc("Do not traverse declarations from system headers"),
+    cl::cat(MyToolCategory));
+
+static cl::opt<InstantiationPolicy> Instantiations(
+    "instantiations",
+    cl::desc("Which implicit template instantiations to match:"),
+    cl::values(
+        clEnumValN(InstantiationPolicy::All, "all", "every instantiation (default)"),
+        clEnumValN(InstantiationPolicy::Primary, "primary", "only templates as written"),
+        clEnumValN(InstantiationPolicy::Unique, "unique",
+                   "each instantiation once per run, by canonical arguments")),
+    cl::init(InstantiationPolicy::All), cl::cat(MyToolCategory));
+
+static cl::opt<unsigned> MatchJobs(
+    "tu-jobs",
+    cl::desc("Match each translation unit on this many threads by splitting\n"
+             "its top-level declarations. Type and name specifier matchers,\n"
+             "queries, the layouts analysis and --instantiations=unique\n"
+             "match serially (default 1)"),
+    cl::init(1), cl::cat(MyToolCategory));
+
+static cl::opt<std::string> ResultCacheDirectory(
+    "result-cache",
+    cl::desc("Reuse the output of translation units whose compile command\n"
+             "and included files are unchanged, kept in this directory.\n"
+             "It may be shared by concurrent runs"),
+    cl::value_desc("directory"), cl::cat(MyToolCategory));
+
+static cl::opt<unsigned> ResultCacheSize(
+    "result-cache-size",
+    cl::desc("Megabytes the result cache may use before the least recently\n"
+             "used entries are removed (default 1024)"),
+    cl::init(1024), cl::cat(MyToolCategory));
+
+static cl::opt<bool> MergedAST(
+    "merged-ast",
+    cl::desc("Import every translation unit into one AST, each declaration\n"
+             "once, and run the analyses' matchers over it a single time.\n"
+             "Matchers on statements are refused, function bodies are not\n"
+             "fully merged"),
+    cl::cat(MyToolCategory));
+
+static cl::opt<bool> FastExit(
+    "fast-exit",
+    cl::desc("Leave the last translation unit's AST and the run's files for\n"
+             "the operating system to reclaim and exit without running\n"
+             "destructors once the output is written"),
+    cl::cat(MyToolCategory));
+
+static cl::opt<bool> RecycleHeap(
+    "recycle-heap",
+    cl::desc("Keep memory freed by a translation unit on the heap for the\n"
+             "next one instead of returning it to the system (default on)"),
+    cl::init(true), cl::cat(MyToolCategory));
+
+static cl::opt<unsigned> HeapReserve(
+    "heap-reserve",
+    cl::desc("Megabytes of heap to fault in before parsing, with\n"
+             "--recycle-heap, at most 1023 (default 0)"),
+    cl::init(0), cl::value_desc("megabytes"), cl::cat(MyToolCategory));
+
+static cl::opt<bool> ShareInvocations(
+    "share-invocations",
+    cl::desc("Run the compiler driver once per distinct compile settings and\n"
+             "reuse its invocation for every file sharing them (default on,\n"
+             "off with --vfs-pack)"),
+    cl::init(true), cl::cat(MyToolCategory));
+
+static cl::opt<std::string> HeaderMapDirectory(
+    "header-maps",
+    cl::desc("Search the -I directories of a compile command through the\n"
+             "header map the headermap subcommand wrote for them into this\n"
+             "directory, when there is one and its directories have not\n"
+             "changed since"),
+    cl::value_desc("directory"), cl::cat(MyToolCategory));
+
+static TraversalScope getTraversalScope() {
+    TraversalScope scope;
+    for (const auto &name : ScopeNamespaces) {
+        scope.Namespaces.push_back(StringRef(name).ltrim(':'));
+    }
+    for (const auto &path : ScopePaths) {
+        SmallString<256> absolutePath(path);
+        sys::fs::make_absolute(absolutePath);
+        sys::path::remove_dots(absolutePath, true);
+        scope.Paths.push_back(absolutePath.str());
+    }
+    scope.SkipSystemHeaders = SkipSystemHeaders;
+    scope.Instantiations = Instantiations;
+    return scope;
+}
+
+// Loaded before the fork-server starts so that its children share them.
+static std::unique_ptr<VfsPack> Pack;
+static std::vector<Query> Queries;
+static MatcherCache CompiledQueries;
+
+static std::vector<std::unique_ptr<Analysis>>
+createAnalyses(ArrayRef<std::string> AnalysisNames) {
+    std::vector<std::unique_ptr<Analysis>> analyses;
+    for (const auto &name : AnalysisNames) {
+        analyses.push_back(createAnalysis(name));
+    }
+    if (!Queries.empty()) {
+        analyses.push_back(llvm::make_unique<QueryAnalysis>(Queries, CompiledQueries));
+    }
+    return analyses;
+}
+
+// Everything besides the compile command that changes what a translation
+// unit prints.
+static std::string getCacheConfiguration(ArrayRef<std::string> AnalysisNames,
+                                         const TraversalScope &Scope) {
+    std::string configuration;
+    raw_string_ostream OS(configuration);
+    for (const auto &name : AnalysisNames) {
+        OS << "analysis\t" << name << "\n";
+    }
+    for (const auto &query : Queries) {
+        OS << "query\t" << query.Label << "\t" << query.Source << "\n";
+    }
+    for (const auto &name : Scope.Namespaces) {
+        OS << "namespace\t" << name << "\n";
+    }
+    for (const auto &path : Scope.Paths) {
+        OS << "path\t" << path << "\n";
+    }
+    OS << "system\t" << Scope.SkipSystemHeaders << "\n";
+    OS << "instantiations\t" << static_cast<int>(Scope.Instantiations) << "\n";
+    return OS.str();
+}
+
+// Counts invocations the way ClangTool makes them, one per compile command,
+// so that the last one can skip its teardown.
+static std::unique_ptr<FrontendActionFactory>
+withFastExit(std::unique_ptr<FrontendActionFactory> Factory,
+             const CompilationDatabase &Compilations, ArrayRef<std::string> SourcePaths) {
+    if (!FastExit) { return Factory; }
+
+    unsigned units = 0;
+    for (const auto &path : SourcePaths) {
+        units += Compilations.getCompileCommands(getAbsolutePath(path)).size();
+    }
+    return newFastExitActionFactory(std::move(Factory), units);
+}
+
+static int runUnits(ClangTool &Tool, const CompilationDatabase &Compilations,
+                    ArrayRef<std::string> SourcePaths, ToolAction &Action) {
+    if (SourcePaths.empty()) { return 0; }
+
+    // Packed files are mapped into ClangTool's own invocations.
+    if (!ShareInvocations || Pack) { return Tool.run(&Action); }
+
+    return runWithSharedInvocations(Tool.getFiles(), Compilations, SourcePaths, Action);
+}
+
+// Takes the outputs of unchanged translation units from the cache and
+// returns the source paths still to run, with the keys to store them under.
+static std::vector<std::string> lookupCachedUnits(ResultCache &Cache,
+                                                  const CompilationDatabase &Compilations,
+                                                  ArrayRef<std::string> SourcePaths,
+                                                  StringMap<std::string> &UnitKeys,
+                                                  StringMap<std::string> &Outputs) {
+    std::vector<std::string> misses;
+    for (const auto &path : SourcePaths) {
+        auto normalizedPath = getNormalizedPath(path);
+        auto commands = Compilations.getCompileCommands(normalizedPath);
+        // A file compiled several ways has one output per way, always run it.
+        if (commands.size() == 1) {
+            auto key = Cache.getUnitKey(commands.front());
+            std::string output;
+            if (Cache.lookup(key, output)) {
+                Outputs[normalizedPath] = std::move(output);
+                continue;
+            }
+            UnitKeys[normalizedPath] = key;
+        }
+        misses.push_back(path);
+    }
+    return misses;
+}
+
+static int runTool(const CompilationDatabase &Compilations,
+                   ArrayRef<std::string> SourcePaths) {
+    AnalysisCompilationDatabase analysisCompilations(Compilations);
+    const CompilationDatabase &adjustedCompilations =
+        UseAnalysisArguments ? analysisCompilations : Compilations;
+    HeaderMapCompilationDatabase headerMapCompilations(adjustedCompilations, HeaderMapDirectory);
+    const CompilationDatabase &compilations =
+        HeaderMapDirectory.empty() ? adjustedCompilations : headerMapCompilations;
+
+    std::vector<std::string> candidatePaths;
+    if (!RequiredIdentifiers.empty()) {
+        LexicalPrefilter prefilter(RequiredIdentifiers);
+        for (const auto &path : SourcePaths) {
+            auto commands = compilations.getCompileCommands(getAbsolutePath(path));
+            if (commands.empty() ||
+                llvm::any_of(commands, [&](const CompileCommand &Command) {
+                    return prefilter.mayMatch(Command);
+                })) {
+                candidatePaths.push_back(path);
+            }
+        }
+        SourcePaths = candidatePaths;
+    }
 
-constexpr auto methodBindName = "method";
-auto MemberFunctionMatcher = cxxMethodDecl().bind(methodBindName);
+    auto analysisNames = getAnalysisNames();
+
+    // Only signatures can be read from tokens, any other analysis or query
+    // needs the full parse anyway. Scopes are applied during traversal, which
+    // the token reader does not have.
+    auto scope = getTraversalScope();
+    ScanResults results;
+
+    std::vector<std::string> clangPaths;
+    if (TieredParsing && Queries.empty() && scope.empty() &&
+        analysisNames == std::vector<std::string>{ "signatures" }) {
+        for (const auto &path : SourcePaths) {
+            auto absolutePath = getAbsolutePath(path);
+            auto commands = compilations.getCompileCommands(absolutePath);
+            if (commands.size() != 1 ||
+                !extractSignatures(absolutePath, commands.front(), results)) {
+                clangPaths.push_back(path);
+            }
+        }
+        SourcePaths = clangPaths;
+    }
 
-class MatchProcessor : public MatchFinder::MatchCallback {
-    raw_ostream& OS{ llvm::errs() };
-    SmallString<20> ClassName;
-    SmallVector<SmallVector<SmallString<20>, 10>, 10> MemberFunctions;
+    std::unique_ptr<ResultCache> cache;
+    StringMap<std::string> unitKeys;
+    StringMap<std::string> outputs;
+    std::vector<std::string> unitPaths(SourcePaths.begin(), SourcePaths.end());
+    std::vector<std::string> missedPaths;
+    if (!ResultCacheDirectory.empty()) {
+        cache = llvm::make_unique<ResultCache>(ResultCacheDirectory,
+                                               uint64_t(ResultCacheSize) << 20,
+                                               getCacheConfiguration(analysisNames, scope));
+        missedPaths = lookupCachedUnits(*cache, compilations, SourcePaths, unitKeys, outputs);
+        SourcePaths = missedPaths;
+    }
 
-public:
-    void run(const MatchFinder::MatchResult &Result) override {
+    ClangTool Tool(compilations, SourcePaths);
 
-        const auto *classTree = Result.Nodes.getNodeAs<clang::CXXRecordDecl>(classBindName);
+    if (UseSharedFileCache) {
+        Tool.getFiles().addStatCache(llvm::make_unique<SharedStatCache>());
+    }
 
-        if (classTree && ClassName.empty()) {
-            ClassName = classTree->getNameAsString();
+    if (Pack) {
+        Pack->mapInto(Tool);
+    }
+
+    // An extra reference the run never drops, the process exit reclaims the
+    // file manager with everything it caches.
+    if (FastExit) {
+        Tool.getFiles().Retain();
+    }
+
+    if (cache) {
+        auto factory = withFastExit(
+            newCachingActionFactory(*cache, unitKeys,
+                                    [&] { return createAnalyses(analysisNames); }, scope,
+                                    MatchJobs, outputs),
+            compilations, SourcePaths);
+        auto ret = runUnits(Tool, compilations, SourcePaths, *factory);
+
+        // Merged the way one set of analyses would have seen the units.
+        auto analyses = createAnalyses(analysisNames);
+        for (const auto &path : unitPaths) {
+            mergeUnitOutput(outputs[getNormalizedPath(path)], analyses);
+        }
+
+        results.print(llvm::outs());
+        for (const auto &analysis : analyses) {
+            analysis->print(llvm::outs());
         }
+        cache->evict();
+        return ret;
+    }
 
-        if (const auto *methodTree = Result.Nodes.getNodeAs<clang::CXXMethodDecl>(methodBindName)) {
+    auto analyses = createAnalyses(analysisNames);
 
-            if (isa<clang::CXXConstructorDecl>(methodTree)) { return; }
+    if (MergedAST) {
+        auto builder = llvm::make_unique<MergedASTBuilder>();
+        auto ret = runUnits(Tool, compilations, SourcePaths, *builder);
+        for (const auto &name : builder->getFailedDecls()) {
+            llvm::errs() << "warning: cannot merge " << name << "\n";
+        }
+        llvm::errs() << "merged-ast: " << builder->getImportedDecls() << " declarations imported, "
+                     << builder->getSkippedDecls() << " already defined, "
+                     << builder->getFailedDecls().size() << " failed\n";
+
+        auto *merged = builder->getMerged();
+        if (merged && !runAnalysesOnAST(analyses, *merged, scope, MatchJobs)) {
+            llvm::errs() << "error: an analysis needs an AST consumer or matches statements, "
+                            "neither can run with --merged-ast\n";
+            return 1;
+        }
 
-            auto returnType = methodTree->getReturnType()->getUnqualifiedDesugaredType();
-            //auto typePtr = returnType.getTypePtr();
+        results.print(llvm::outs());
+        for (const auto &analysis : analyses) {
+            analysis->print(llvm::outs());
+        }
+        if (FastExit) {
+            BuryPointer(std::move(builder));
+        }
+        return ret;
+    }
 
-            auto ptr = methodTree->getReturnType()->getCanonicalTypeUnqualified();
+    auto factory = withFastExit(newAnalysisActionFactory(analyses, scope, MatchJobs),
+                                compilations, SourcePaths);
 
-            //auto print = methodTree->getReturnType()->getCanonicalTypeInternal()->getTypeClassName();
+    auto ret = runUnits(Tool, compilations, SourcePaths, *factory);
 
-            //OS << methodTree->getReturnType()->decl <<  "========================\n";
-            returnType->dump();
+    results.print(llvm::outs());
+    for (const auto &analysis : analyses) {
+        analysis->print(llvm::outs());
+    }
 
-            if (!returnType->isBuiltinType()) {
-                //auto print = methodTree->getReturnType()->getTypeClassName();// returnType->getTypeClassName();
-                //OS << print << " " << methodTree->getDeclName() << "\n\n";
+    return ret;
+}
+
+// The fork-server takes its source paths from requests, so it must be allowed
+// to start without any on the command line.
+static bool isForkServerRequested(int argc, const char **argv) {
+    for (auto i = 1; i < argc; ++i) {
+        auto arg = StringRef(argv[i]);
+        if (arg == "--") { break; }
+        // Other options share the prefix, e.g. --fork-server-socket.
+        StringRef name, value;
+        std::tie(name, value) = arg.ltrim('-').split('=');
+        if (name == "fork-server") {
+            return value.empty() || value == "true" || value == "TRUE" || value == "True" ||
+                   value == "1";
+        }
+    }
+    return false;
+}
+
+static int startForkServer(CommonOptionsParser &OptionsParser) {
+    // CommonOptionsParser only loads a database when given source paths, and
+    // getCompilations() must not be called otherwise.
+    if (!OptionsParser.getSourcePathList().empty()) {
+        auto &compilations = OptionsParser.getCompilations();
+        return runForkServer(ForkServerSocket, [&](ArrayRef<std::string> SourcePaths) {
+            return runTool(compilations, SourcePaths);
+        });
+    }
+
+    if (ForkServerBuildPath.empty()) {
+        llvm::errs() << "error: --fork-server without source paths requires "
+                        "--fork-server-build-path=<directory>\n";
+        return 1;
+    }
+
+    std::string errorMessage;
+    auto compilations = CompilationDatabase::autoDetectFromDirectory(ForkServerBuildPath,
+                                                                     errorMessage);
+    if (!compilations) {
+        llvm::errs() << "error: " << errorMessage << "\n";
+        return 1;
+    }
+
+    return runForkServer(ForkServerSocket, [&](ArrayRef<std::string> SourcePaths) {
+        return runTool(*compilations, SourcePaths);
+    });
+}
+
+// Subcommands replace the default scan when named as the first argument.
+static const struct {
+    const char *Name;
+    int (*Run)(int argc, const char **argv);
+} Commands[] = {
+    { "pack", runPackCommand },
+    { "merge", runMergeCommand },
+    { "codegen", runCodegenCommand },
+    { "index", runIndexCommand },
+    { "query", runQueryCommand },
+    { "graph", runGraphCommand },
+    { "headermap", runHeaderMapCommand },
+};
+
+int main(int argc, const char **argv) {
+    if (argc > 1) {
+        for (const auto &command : Commands) {
+            if (StringRef(argv[1]) == command.Name) {
+                return command.Run(argc - 1, argv + 1);
             }
+        }
+    }
+
+    auto forkServer = isForkServerRequested(argc, argv);
+
+    CommonOptionsParser OptionsParser(argc, argv, MyToolCategory,
+        forkServer ? cl::ZeroOrMore : cl::OneOrMore);
+
+    if (RequiredIdentifiers.size() > LexicalPrefilter::MaxIdentifiers) {
+        llvm::errs() << "error: at most " << LexicalPrefilter::MaxIdentifiers
+                     << " identifiers can be required\n";
+        return 1;
+    }
+    if (llvm::is_contained(RequiredIdentifiers, "")) {
+        llvm::errs() << "error: --require-identifier needs a non-empty identifier\n";
+        return 1;
+    }
+
+    if (HeapReserve > MaxHeapReserveMegabytes) {
+        llvm::errs() << "error: --heap-reserve can be at most " << MaxHeapReserveMegabytes
+                     << " megabytes\n";
+        return 1;
+    }
 
+    for (const auto &name : getAnalysisNames()) {
+        auto analysis = createAnalysis(name);
+        if (!analysis) {
+            llvm::errs() << "error: unknown analysis '" << name << "', available:";
+            for (const auto &entry : AnalysisRegistry::entries()) {
+                llvm::errs() << " " << entry.getName();
+            }
+            llvm::errs() << "\n";
+            return 1;
+        }
+        if (MergedAST && analysis->usesASTConsumer()) {
+            llvm::errs() << "error: analysis '" << name << "' cannot run with --merged-ast\n";
+            return 1;
+        }
+        // Scopes prune the matchers' traversal, consumers see every declaration.
+        if (analysis->usesASTConsumer() && !getTraversalScope().empty()) {
+            llvm::errs() << "error: analysis '" << name << "' ignores --scope-namespace, "
+                            "--scope-path, --skip-system-headers and --instantiations\n";
+            return 1;
         }
+    }
 
+    if (MergedAST && !ResultCacheDirectory.empty()) {
+        llvm::errs() << "error: --merged-ast and --result-cache cannot be combined\n";
+        return 1;
     }
 
-    void printData() {
-        //OS << ClassName;
+    // Units are cached apart, the instantiations one has seen are lost.
+    if (Instantiations == InstantiationPolicy::Unique && !ResultCacheDirectory.empty()) {
+        llvm::errs() << "error: --instantiations=unique and --result-cache cannot be combined\n";
+        return 1;
+    }
 
-        for (auto& function : MemberFunctions) {
+    for (const auto &path : QueryFiles) {
+        std::string errorMessage;
+        if (!loadQueryFile(path, Queries, errorMessage)) {
+            llvm::errs() << "error: " << errorMessage << "\n";
+            return 1;
+        }
+    }
 
+    for (const auto &query : Queries) {
+        std::string errorMessage;
+        if (!CompiledQueries.get(query.Source, errorMessage)) {
+            llvm::errs() << query.Label << ": error: " << errorMessage << "\n";
+            return 1;
         }
+    }
 
-        OS << "\n";
+    // Function bodies are only partly merged, see MergedAST.h.
+    if (MergedAST && getMatchedNodeKinds(createAnalyses(getAnalysisNames())).Stmts) {
+        llvm::errs() << "error: --merged-ast cannot run analyses or queries that match "
+                        "statements\n";
+        return 1;
     }
-};
 
-int main(int argc, const char **argv) {
-    CommonOptionsParser OptionsParser(argc, argv, MyToolCategory);
-    ClangTool Tool(OptionsParser.getCompilations(),
-        OptionsParser.getSourcePathList());
+    if (!VfsPackPath.empty()) {
+        std::string errorMessage;
+        Pack = VfsPack::load(VfsPackPath, errorMessage);
+        if (!Pack) {
+            llvm::errs() << "error: " << errorMessage << "\n";
+            return 1;
+        }
+    }
 
-    MatchProcessor Printer;
-    MatchFinder Finder;
-    Finder.addMatcher(ClassDeclMatcher, &Printer);
-    Finder.addMatcher(MemberFunctionMatcher, &Printer);
+    // Before the fork-server starts, so that its children inherit it.
+    if (RecycleHeap) {
+        tuneHeapForParsing(HeapReserve);
+    }
 
-    auto ret = Tool.run(newFrontendActionFactory(&Finder).get());
+    if (forkServer) {
+        return startForkServer(OptionsParser);
+    }
+
+    auto ret = runTool(OptionsParser.getCompilations(),
+        OptionsParser.getSourcePathList());
 
-    Printer.printData();
+    if (FastExit) {
+        exitFast(ret);
+    }
 
     system("pause");
 
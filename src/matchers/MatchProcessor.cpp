@@ -0,0 +1,57 @@
+#include "MatchProcessor.h"
+
+#include "clang/AST/DeclTemplate.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace llvm;
+
+constexpr auto classBindName = "class";
+static auto ClassDeclMatcher = cxxRecordDecl(isDefinition()).bind(classBindName);
+
+void MatchProcessor::run(const MatchFinder::MatchResult &Result) {
+    const auto *classTree = Result.Nodes.getNodeAs<clang::CXXRecordDecl>(classBindName);
+    if (!classTree) { return; }
+
+    auto &sourceManager = *Result.SourceManager;
+
+    // Spell types as written, the way the tier-1 extractor reports them.
+    auto policy = Result.Context->getPrintingPolicy();
+    policy.SuppressScope = true;
+
+    ClassRecord record;
+    record.QualifiedName = classTree->getQualifiedNameAsString();
+    record.File = sourceManager.getFilename(
+        sourceManager.getSpellingLoc(classTree->getLocation()));
+
+    // Walk the definition's own methods rather than matching every method in
+    // the AST and relying on match order to find its class. methods() skips
+    // member function templates.
+    for (const auto *member : classTree->decls()) {
+        if (const auto *templ = dyn_cast<FunctionTemplateDecl>(member)) {
+            member = templ->getTemplatedDecl();
+        }
+        const auto *methodTree = dyn_cast<CXXMethodDecl>(member);
+        if (!methodTree || isa<clang::CXXConstructorDecl>(methodTree) ||
+            methodTree->isImplicit()) {
+            continue;
+        }
+
+        MethodRecord method;
+        method.Name = methodTree->getNameAsString();
+        method.ReturnType = methodTree->getReturnType().getAsString(policy);
+        for (const auto *parameter : methodTree->parameters()) {
+            method.ParameterTypes.push_back(parameter->getType().getAsString(policy));
+        }
+        method.IsConst = methodTree->isConst();
+
+        record.Methods.push_back(std::move(method));
+    }
+
+    Results.Classes.push_back(std::move(record));
+}
+
+void addScanMatchers(MatcherList &Matchers, MatchProcessor &Processor) {
+    Matchers.add(ClassDeclMatcher, &Processor);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+
+#include "matchers/MatcherList.h"
+#include "results/ScanResults.h"
+
+// Collects class definitions and their methods into a ScanResults.
+class MatchProcessor : public clang::ast_matchers::MatchFinder::MatchCallback {
+    llvm::raw_ostream &OS{ llvm::outs() };
+    ScanResults &Results;
+
+public:
+    explicit MatchProcessor(ScanResults &Results) : Results(Results) {}
+
+    void run(const clang::ast_matchers::MatchFinder::MatchResult &Result) override;
+
+    void printData() {
+        Results.print(OS);
+    }
+};
+
+// Registers the class definition matcher that feeds Processor. Methods are
+// read from each definition, so one match yields a whole class.
+void addScanMatchers(MatcherList &Matchers, MatchProcessor &Processor);
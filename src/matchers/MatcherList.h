@@ -0,0 +1,84 @@
+#pragma once
+
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "llvm/ADT/STLExtras.h"
+
+#include <utility>
+#include <vector>
+
+// Matchers and the callbacks they report to, kept apart from any one
+// MatchFinder so the same set can be added to several, e.g. one finder per
+// thread with each callback wrapped.
+class MatcherList {
+public:
+    typedef clang::ast_matchers::MatchFinder::MatchCallback Callback;
+    typedef clang::ast_matchers::internal::DynTypedMatcher Matcher;
+
+private:
+    std::vector<std::pair<Matcher, Callback *>> Matchers;
+
+public:
+    void add(const Matcher &NodeMatch, Callback *Action) {
+        Matchers.emplace_back(NodeMatch, Action);
+    }
+
+    void addTo(clang::ast_matchers::MatchFinder &Finder) const {
+        addTo(Finder, [](Callback *Action) { return Action; });
+    }
+
+    // Adds every matcher to Finder, reporting to Wrap(Action) instead.
+    void addTo(clang::ast_matchers::MatchFinder &Finder,
+               llvm::function_ref<Callback *(Callback *)> Wrap) const {
+        for (const auto &matcher : Matchers) {
+            Finder.addDynamicMatcher(matcher.first, Wrap(matcher.second));
+        }
+    }
+
+    // The node categories MatchFinder sorts the matchers into, in the order
+    // addDynamicMatcher tries them, so that traversals matching one node at
+    // a time can skip nodes nothing would match.
+    struct NodeKinds {
+        bool Decls = false;
+        bool Stmts = false;
+        bool Types = false;
+        bool TypeLocs = false;
+        bool Specifiers = false;
+        bool SpecifierLocs = false;
+
+        bool onlyDeclsOrStmts() const {
+            return !Types && !TypeLocs && !Specifiers && !SpecifierLocs;
+        }
+    };
+
+    NodeKinds getNodeKinds() const {
+        NodeKinds kinds;
+        for (const auto &matcher : Matchers) {
+            const auto &m = matcher.first;
+            if (m.canConvertTo<clang::Decl>()) {
+                kinds.Decls = true;
+            } else if (m.canConvertTo<clang::QualType>()) {
+                kinds.Types = true;
+            } else if (m.canConvertTo<clang::Stmt>()) {
+                kinds.Stmts = true;
+            } else if (m.canConvertTo<clang::NestedNameSpecifier>()) {
+                kinds.Specifiers = true;
+            } else if (m.canConvertTo<clang::NestedNameSpecifierLoc>()) {
+                kinds.SpecifierLocs = true;
+            } else if (m.canConvertTo<clang::TypeLoc>()) {
+                kinds.TypeLocs = true;
+            }
+        }
+        return kinds;
+    }
+
+    // Each distinct callback once, in the order first added.
+    std::vector<Callback *> getCallbacks() const {
+        std::vector<Callback *> callbacks;
+        for (const auto &matcher : Matchers) {
+            if (!llvm::is_contained(callbacks, matcher.second)) {
+                callbacks.push_back(matcher.second);
+            }
+        }
+        return callbacks;
+    }
+};
@@ -0,0 +1,86 @@
+#include "MergedAST.h"
+
+#include "clang/AST/ASTImporter.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Index/USRGeneration.h"
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+// For templates, whether the templated declaration is a definition.
+// Declarations that cannot be redeclared count as definitions.
+static bool isDefinition(const Decl *D) {
+    if (const auto *templ = dyn_cast<TemplateDecl>(D)) {
+        if (!templ->getTemplatedDecl()) { return true; }
+        D = templ->getTemplatedDecl();
+    }
+    if (const auto *tag = dyn_cast<TagDecl>(D)) { return tag->isThisDeclarationADefinition(); }
+    if (const auto *function = dyn_cast<FunctionDecl>(D)) {
+        return function->isThisDeclarationADefinition();
+    }
+    if (const auto *var = dyn_cast<VarDecl>(D)) {
+        return var->isThisDeclarationADefinition() != VarDecl::DeclarationOnly;
+    }
+    return true;
+}
+
+// Walks into namespaces and linkage specifications so that a namespace
+// reopened by many headers is merged declaration by declaration. With no
+// importer it only records what the merged AST already holds.
+void MergedASTBuilder::importDecls(DeclContext &Context, ASTImporter *Importer) {
+    for (auto *decl : Context.decls()) {
+        if (decl->isImplicit() || decl->isInvalidDecl()) { continue; }
+
+        if (isa<NamespaceDecl>(decl) || isa<LinkageSpecDecl>(decl)) {
+            importDecls(*cast<DeclContext>(decl), Importer);
+            continue;
+        }
+
+        // Declarations without a USR, such as static_asserts, are always
+        // imported.
+        SmallString<128> usr;
+        if (!index::generateUSRForDecl(decl, usr)) {
+            if (Defined.count(usr)) {
+                ++SkippedDecls;
+                continue;
+            }
+            if (isDefinition(decl)) { Defined.insert(usr); }
+        }
+
+        if (!Importer) { continue; }
+        if (Importer->Import(decl)) {
+            ++ImportedDecls;
+        } else if (const auto *named = dyn_cast<NamedDecl>(decl)) {
+            FailedDecls.push_back(named->getQualifiedNameAsString());
+        } else {
+            FailedDecls.push_back(decl->getDeclKindName());
+        }
+    }
+}
+
+bool MergedASTBuilder::runInvocation(std::shared_ptr<CompilerInvocation> Invocation,
+                                     FileManager *Files,
+                                     std::shared_ptr<PCHContainerOperations> PCHContainerOps,
+                                     DiagnosticConsumer *DiagConsumer) {
+    auto unit = ASTUnit::LoadFromCompilerInvocation(
+        Invocation, std::move(PCHContainerOps),
+        CompilerInstance::createDiagnostics(&Invocation->getDiagnosticOpts(), DiagConsumer,
+                                            /*ShouldOwnClient=*/false),
+        Files);
+    if (!unit) { return false; }
+
+    auto succeeded = !unit->getDiagnostics().hasErrorOccurred();
+    if (!Merged) {
+        Merged = std::move(unit);
+        importDecls(*Merged->getASTContext().getTranslationUnitDecl(), nullptr);
+        return succeeded;
+    }
+
+    ASTImporter importer(Merged->getASTContext(), Merged->getFileManager(),
+                         unit->getASTContext(), unit->getFileManager(),
+                         /*MinimalImport=*/false);
+    importDecls(*unit->getASTContext().getTranslationUnitDecl(), &importer);
+    return succeeded;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+
+#include "llvm/ADT/StringSet.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+class ASTImporter;
+}
+
+// Builds one AST holding the declarations of every translation unit, so a
+// header's declarations exist once however many units include it and a
+// query traverses them once.
+//
+// The first unit parsed becomes the merged AST. Each following unit is
+// parsed, its declarations are copied over with clang::ASTImporter, and the
+// unit is freed before the next is parsed. A declaration is skipped only
+// when a definition with its USR is already present, so a unit that only
+// forward declares a class never hides the definition another unit has.
+//
+// ASTImporter maps a function onto an existing declaration with the same
+// signature and drops the body it brings, so the bodies of out-of-line
+// definitions come from the first unit that declared the function and are
+// missing when that unit only declared it. Statements cannot be matched
+// over the merged AST.
+class MergedASTBuilder : public clang::tooling::ToolAction {
+    std::unique_ptr<clang::ASTUnit> Merged;
+    // USRs of the definitions in the merged AST.
+    llvm::StringSet<> Defined;
+    unsigned ImportedDecls = 0;
+    unsigned SkippedDecls = 0;
+    std::vector<std::string> FailedDecls;
+
+    void importDecls(clang::DeclContext &Context, clang::ASTImporter *Importer);
+
+public:
+    bool runInvocation(std::shared_ptr<clang::CompilerInvocation> Invocation,
+                       clang::FileManager *Files,
+                       std::shared_ptr<clang::PCHContainerOperations> PCHContainerOps,
+                       clang::DiagnosticConsumer *DiagConsumer) override;
+
+    // Null until a unit has been parsed.
+    clang::ASTUnit *getMerged() { return Merged.get(); }
+
+    unsigned getImportedDecls() const { return ImportedDecls; }
+    unsigned getSkippedDecls() const { return SkippedDecls; }
+
+    // Names of the declarations ASTImporter could not import.
+    const std::vector<std::string> &getFailedDecls() const { return FailedDecls; }
+};
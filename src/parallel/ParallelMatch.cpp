@@ -0,0 +1,104 @@
+#include "ParallelMatch.h"
+
+#include "clang/AST/ASTContext.h"
+#include "llvm/Support/ThreadPool.h"
+
+#include <algorithm>
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace llvm;
+
+// More chunks than threads so that one dense chunk does not leave the rest
+// of the pool idle.
+constexpr size_t ChunksPerJob = 4;
+
+namespace {
+
+typedef std::vector<std::pair<MatchFinder::MatchCallback *, BoundNodes>> RecordedMatches;
+
+// Stands in for a callback on a worker thread.
+class RecordingCallback : public MatchFinder::MatchCallback {
+    MatchFinder::MatchCallback &Target;
+    RecordedMatches &Matches;
+
+public:
+    RecordingCallback(MatchFinder::MatchCallback &Target, RecordedMatches &Matches)
+        : Target(Target), Matches(Matches) {}
+
+    void run(const MatchFinder::MatchResult &Result) override {
+        Matches.emplace_back(&Target, Result.Nodes);
+    }
+};
+
+struct Chunk {
+    ArrayRef<Decl *> Decls;
+    RecordedMatches Matches;
+};
+
+class ParallelMatchConsumer : public ASTConsumer {
+    const MatcherList &Matchers;
+    const TraversalScope &Scope;
+    unsigned Jobs;
+
+    void matchChunk(ASTContext &Context, Chunk &Current) {
+        MatchFinder finder;
+        std::vector<std::unique_ptr<RecordingCallback>> recorders;
+        Matchers.addTo(finder, [&](MatchFinder::MatchCallback *Target) {
+            recorders.push_back(llvm::make_unique<RecordingCallback>(*Target, Current.Matches));
+            return recorders.back().get();
+        });
+
+        // Unused, the unique policy never gets here.
+        StringSet<> instantiations;
+        matchInScope(finder, Matchers, Context, Scope, Current.Decls, instantiations,
+                     instantiations);
+    }
+
+public:
+    ParallelMatchConsumer(const MatcherList &Matchers, const TraversalScope &Scope,
+                          unsigned Jobs)
+        : Matchers(Matchers), Scope(Scope), Jobs(Jobs) {}
+
+    void HandleTranslationUnit(ASTContext &Context) override {
+        auto *unit = Context.getTranslationUnitDecl();
+        std::vector<Decl *> decls(unit->decls_begin(), unit->decls_end());
+        if (decls.empty()) { return; }
+
+        // Built lazily on first use otherwise, which would race.
+        Context.getParents(*decls.front());
+
+        std::vector<Chunk> chunks(std::min(decls.size(), Jobs * ChunksPerJob));
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            auto begin = decls.size() * i / chunks.size();
+            auto end = decls.size() * (i + 1) / chunks.size();
+            chunks[i].Decls = makeArrayRef(decls).slice(begin, end - begin);
+        }
+
+        ThreadPool pool(Jobs);
+        for (auto &chunk : chunks) {
+            auto *current = &chunk;
+            pool.async([this, &Context, current] { matchChunk(Context, *current); });
+        }
+        pool.wait();
+
+        for (auto &chunk : chunks) {
+            for (const auto &match : chunk.Matches) {
+                match.first->run(MatchFinder::MatchResult(match.second, &Context));
+            }
+        }
+    }
+};
+
+}
+
+bool canMatchInParallel(const MatcherList &Matchers, const TraversalScope &Scope) {
+    return Matchers.getNodeKinds().onlyDeclsOrStmts() &&
+           Scope.Instantiations != InstantiationPolicy::Unique;
+}
+
+std::unique_ptr<ASTConsumer> newParallelMatchConsumer(const MatcherList &Matchers,
+                                                      const TraversalScope &Scope,
+                                                      unsigned Jobs) {
+    return llvm::make_unique<ParallelMatchConsumer>(Matchers, Scope, Jobs);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "clang/AST/ASTConsumer.h"
+
+#include "matchers/MatcherList.h"
+#include "scope/TraversalScope.h"
+
+#include <memory>
+
+// Matches one translation unit on several threads. Its top-level declarations
+// are split into contiguous chunks and each chunk gets its own MatchFinder
+// over the shared ASTContext. Callbacks do not run on the workers: their
+// matches are recorded and delivered on the calling thread in source order,
+// so the callbacks need no locking and output is the same as a serial run.
+//
+// Matchers must only read the AST. The parent map is built before the
+// workers start so hasParent and hasAncestor are safe. Matchers that inspect
+// source locations, or that make ASTContext compute and cache something such
+// as a type's size or layout, race with each other and must not be used;
+// runs whose analyses report needsSerialMatching() never get here.
+
+// False when the matchers need the serial traversal: any matcher on types,
+// type locations or name specifiers, which are matched as MatchFinder sees
+// them, or the unique instantiation policy, which must see the units' chunks
+// in order.
+bool canMatchInParallel(const MatcherList &Matchers, const TraversalScope &Scope);
+
+// Only for matchers canMatchInParallel accepts.
+std::unique_ptr<clang::ASTConsumer>
+newParallelMatchConsumer(const MatcherList &Matchers, const TraversalScope &Scope, unsigned Jobs);
@@ -0,0 +1,105 @@
+// Runs the scan as a clang plugin so it piggybacks on a normal build:
+//
+//   clang++ -fplugin=libExecutableNameScan.so -c foo.cpp -o foo.o
+//
+// The library is the ${executable_name}Scan target of cmake/LinMakeLists.txt,
+// named after the executable.
+//
+// The AST the compiler builds anyway is matched after parsing and the results
+// are written next to the object file as foo.o.scan. The "merge" subcommand
+// combines the sidecars into a single report.
+//
+// Arguments, passed with -Xclang -plugin-arg-scan-signatures -Xclang <arg>:
+//   out=<file>   write the sidecar to <file> instead
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendPluginRegistry.h"
+
+#include "llvm/Support/FileSystem.h"
+
+#include "matchers/MatchProcessor.h"
+#include "results/ScanResults.h"
+#include "support/BinaryFile.h"
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace llvm;
+
+namespace {
+
+class ScanConsumer : public ASTConsumer {
+    std::string OutputPath;
+    ScanResults Results;
+    MatchProcessor Processor{ Results };
+    MatchFinder Finder;
+
+public:
+    explicit ScanConsumer(std::string OutputPath) : OutputPath(std::move(OutputPath)) {
+        MatcherList matchers;
+        addScanMatchers(matchers, Processor);
+        matchers.addTo(Finder);
+    }
+
+    void HandleTranslationUnit(ASTContext &Context) override {
+        // Errors already fail the build, a partial sidecar would only mislead.
+        // Neither may one left over from an earlier successful build.
+        if (Context.getDiagnostics().hasErrorOccurred()) {
+            sys::fs::remove(OutputPath);
+            return;
+        }
+
+        Finder.matchAST(Context);
+
+        auto ec = writeStreamAtomically(OutputPath, [&](raw_ostream &OS) {
+            Results.print(OS);
+        });
+        if (ec) {
+            auto &diagnostics = Context.getDiagnostics();
+            diagnostics.Report(diagnostics.getCustomDiagID(
+                DiagnosticsEngine::Warning, "cannot write scan results to '%0': %1"))
+                << OutputPath << ec.message();
+        }
+    }
+};
+
+class ScanAction : public PluginASTAction {
+    std::string OutputPath;
+
+protected:
+    std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
+                                                   StringRef InFile) override {
+        auto outputPath = OutputPath;
+        if (outputPath.empty()) {
+            const auto &objectFile = CI.getFrontendOpts().OutputFile;
+            outputPath = (objectFile.empty() || objectFile == "-" ? InFile.str() : objectFile) + ".scan";
+        }
+        return llvm::make_unique<ScanConsumer>(std::move(outputPath));
+    }
+
+    bool ParseArgs(const CompilerInstance &CI, const std::vector<std::string> &Args) override {
+        for (const auto &arg : Args) {
+            StringRef value(arg);
+            if (value.consume_front("out=")) {
+                OutputPath = value;
+                continue;
+            }
+
+            auto &diagnostics = CI.getDiagnostics();
+            diagnostics.Report(diagnostics.getCustomDiagID(
+                DiagnosticsEngine::Error, "unknown scan-signatures argument '%0'"))
+                << arg;
+            return false;
+        }
+        return true;
+    }
+
+    // Run alongside code generation instead of replacing it.
+    ActionType getActionType() override { return AddBeforeMainAction; }
+};
+
+}
+
+static FrontendPluginRegistry::Add<ScanAction>
+    X("scan-signatures", "write class and method signatures next to the object file");
@@ -0,0 +1,90 @@
+#include "SidecarMerge.h"
+
+#include "results/ScanResults.h"
+#include "support/BinaryFile.h"
+
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+static void collectSidecars(StringRef Path, std::vector<std::string> &Sidecars) {
+    if (!sys::fs::is_directory(Path)) {
+        Sidecars.push_back(Path);
+        return;
+    }
+
+    std::error_code ec;
+    for (sys::fs::recursive_directory_iterator it(Path, ec), end; it != end && !ec; it.increment(ec)) {
+        if (sys::path::extension(it->path()) == ".scan") {
+            Sidecars.push_back(it->path());
+        }
+    }
+}
+
+// Classes in an anonymous namespace or local to a function are printed with
+// a parenthesised scope and are distinct in every file that defines them, so
+// only their copies from the same file are the same class.
+static std::string getMergeKey(const ClassRecord &Record) {
+    if (!StringRef(Record.QualifiedName).contains('(')) { return Record.QualifiedName; }
+    return Record.QualifiedName + '\0' + Record.File;
+}
+
+int runMergeCommand(int argc, const char **argv) {
+    std::string outputPath;
+    std::vector<std::string> sidecars;
+
+    for (int i = 1; i < argc; ++i) {
+        StringRef arg(argv[i]);
+        if (arg.consume_front("--merge-output=")) {
+            outputPath = arg;
+            continue;
+        }
+        collectSidecars(arg, sidecars);
+    }
+
+    if (sidecars.empty()) {
+        errs() << "error: merge requires at least one .scan file or directory\n";
+        return 1;
+    }
+
+    // Directory order is arbitrary, sort so the report is reproducible.
+    std::sort(sidecars.begin(), sidecars.end());
+
+    ScanResults merged;
+    StringSet<> seen;
+    auto ret = 0;
+
+    for (const auto &sidecar : sidecars) {
+        auto buffer = MemoryBuffer::getFile(sidecar);
+        ScanResults results;
+        if (!buffer || !results.parse((*buffer)->getBuffer())) {
+            errs() << "error: cannot read " << sidecar << "\n";
+            ret = 1;
+            continue;
+        }
+
+        // Headers are compiled into many objects, keep the first copy.
+        for (auto &record : results.Classes) {
+            if (seen.insert(getMergeKey(record)).second) {
+                merged.Classes.push_back(std::move(record));
+            }
+        }
+    }
+
+    if (outputPath.empty()) {
+        merged.print(outs());
+        return ret;
+    }
+
+    if (auto ec = writeStreamAtomically(outputPath, [&](raw_ostream &OS) { merged.print(OS); })) {
+        errs() << "error: cannot write " << outputPath << ": " << ec.message() << "\n";
+        return 1;
+    }
+
+    return ret;
+}
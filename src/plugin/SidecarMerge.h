@@ -0,0 +1,11 @@
+#pragma once
+
+// The "merge" subcommand: combines the .scan sidecars the compiler plugin
+// wrote during a build into one report.
+//
+//   ExecutableName merge [--merge-output=<file>] <file or directory>...
+//
+// Directories are searched recursively for *.scan files. A class seen in
+// several translation units is reported once, unless it is in an anonymous
+// namespace or local to a function and the copies come from different files.
+int runMergeCommand(int argc, const char **argv);
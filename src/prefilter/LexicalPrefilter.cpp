@@ -0,0 +1,306 @@
+#include "LexicalPrefilter.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+#include <cassert>
+#include <cctype>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PREFILTER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define PREFILTER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PREFILTER_TARGET_AVX2
+#endif
+
+using namespace clang::tooling;
+using namespace llvm;
+
+static bool isIdentifierChar(char C) {
+    return std::isalnum(static_cast<unsigned char>(C)) || C == '_';
+}
+
+static bool isMatchAt(StringRef Text, size_t Pos, StringRef Identifier) {
+    auto end = Pos + Identifier.size();
+    if (end > Text.size() ||
+        std::memcmp(Text.data() + Pos, Identifier.data(), Identifier.size()) != 0) {
+        return false;
+    }
+    return (Pos == 0 || !isIdentifierChar(Text[Pos - 1])) &&
+           (end == Text.size() || !isIdentifierChar(Text[end]));
+}
+
+static bool findScalar(StringRef Text, StringRef Identifier, size_t Start) {
+    for (auto pos = Text.find(Identifier.front(), Start); pos != StringRef::npos;
+         pos = Text.find(Identifier.front(), pos + 1)) {
+        if (isMatchAt(Text, pos, Identifier)) { return true; }
+    }
+    return false;
+}
+
+#ifdef PREFILTER_X86
+
+// Candidate positions are those where both the first and the last byte of
+// the identifier line up, which rejects almost everything in one compare.
+static bool findSSE2(StringRef Text, StringRef Identifier) {
+    const auto lastOffset = Identifier.size() - 1;
+    const auto first = _mm_set1_epi8(Identifier.front());
+    const auto last = _mm_set1_epi8(Identifier.back());
+
+    size_t i = 0;
+    for (; i + lastOffset + 16 <= Text.size(); i += 16) {
+        auto blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Text.data() + i));
+        auto blockLast = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(Text.data() + i + lastOffset));
+
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, blockFirst),
+                                                        _mm_cmpeq_epi8(last, blockLast)));
+        while (mask) {
+            if (isMatchAt(Text, i + countTrailingZeros(mask), Identifier)) { return true; }
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(Text, Identifier, i);
+}
+
+PREFILTER_TARGET_AVX2
+static bool findAVX2(StringRef Text, StringRef Identifier) {
+    const auto lastOffset = Identifier.size() - 1;
+    const auto first = _mm256_set1_epi8(Identifier.front());
+    const auto last = _mm256_set1_epi8(Identifier.back());
+
+    size_t i = 0;
+    for (; i + lastOffset + 32 <= Text.size(); i += 32) {
+        auto blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(Text.data() + i));
+        auto blockLast = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(Text.data() + i + lastOffset));
+
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast)));
+        while (mask) {
+            if (isMatchAt(Text, i + countTrailingZeros(mask), Identifier)) { return true; }
+            mask &= mask - 1;
+        }
+    }
+    return findScalar(Text, Identifier, i);
+}
+
+static bool hasAVX2() {
+#if defined(__GNUC__)
+    static const bool HasAVX2 = __builtin_cpu_supports("avx2");
+    return HasAVX2;
+#elif defined(_MSC_VER)
+    static const bool HasAVX2 = [] {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) { return false; }
+
+        // AVX2 also needs the OS to save the upper halves of the registers.
+        __cpuid(info, 1);
+        const auto osxsave = (info[2] & (1 << 27)) != 0;
+        if (!osxsave || (_xgetbv(0) & 6) != 6) { return false; }
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return HasAVX2;
+#else
+    return false;
+#endif
+}
+
+#endif
+
+bool containsIdentifier(StringRef Text, StringRef Identifier) {
+    assert(!Identifier.empty() && "searching for an empty identifier");
+
+#ifdef PREFILTER_X86
+    return hasAVX2() ? findAVX2(Text, Identifier) : findSSE2(Text, Identifier);
+#else
+    return findScalar(Text, Identifier, 0);
+#endif
+}
+
+LexicalPrefilter::LexicalPrefilter(std::vector<std::string> Identifiers)
+    : Identifiers(std::move(Identifiers)) {
+    assert(this->Identifiers.size() <= MaxIdentifiers && "too many identifiers");
+    AllFound = this->Identifiers.size() == 64 ? ~uint64_t(0)
+                                              : (uint64_t(1) << this->Identifiers.size()) - 1;
+}
+
+void LexicalPrefilter::collectIncludes(StringRef Text, FileScan &Scan) {
+    while (!Text.empty()) {
+        StringRef line;
+        std::tie(line, Text) = Text.split('\n');
+
+        line = line.ltrim();
+        if (!line.consume_front("#")) { continue; }
+
+        line = line.ltrim();
+        if (!line.consume_front("include") && !line.consume_front("import")) { continue; }
+        line.consume_front("_next");
+        line = line.ltrim();
+
+        if (line.startswith("\"") || line.startswith("<")) {
+            auto isAngled = line.front() == '<';
+            auto end = line.find(isAngled ? '>' : '"', 1);
+            if (end != StringRef::npos) {
+                Scan.Includes.push_back({ line.slice(1, end), isAngled });
+                continue;
+            }
+        }
+
+        Scan.HasMacroInclude = true;
+    }
+}
+
+const LexicalPrefilter::FileScan &LexicalPrefilter::scan(StringRef Path) {
+    auto inserted = Scans.insert({ Path, FileScan() });
+    auto &fileScan = inserted.first->second;
+    if (!inserted.second) { return fileScan; }
+
+    auto buffer = MemoryBuffer::getFile(Path, -1, /*RequiresNullTerminator=*/false);
+    if (!buffer) { return fileScan; }
+
+    auto text = (*buffer)->getBuffer();
+    fileScan.Exists = true;
+
+    for (size_t i = 0; i < Identifiers.size(); ++i) {
+        if (containsIdentifier(text, Identifiers[i])) {
+            fileScan.Found |= uint64_t(1) << i;
+        }
+    }
+
+    collectIncludes(text, fileScan);
+    return fileScan;
+}
+
+static void makeAbsolute(StringRef Directory, SmallVectorImpl<char> &Path) {
+    if (!sys::path::is_absolute(Path)) {
+        SmallString<256> absolute(Directory);
+        sys::path::append(absolute, StringRef(Path.data(), Path.size()));
+        Path.swap(absolute);
+    }
+    sys::path::remove_dots(Path);
+}
+
+bool LexicalPrefilter::mayMatch(const CompileCommand &Command) {
+    // Quoted includes search these first, both also search the rest.
+    std::vector<std::string> quotedDirectories;
+    std::vector<std::string> directories;
+    // Files named by -include and -imacros, read ahead of the main file.
+    std::vector<std::string> forcedFiles;
+
+    const auto &args = Command.CommandLine;
+    for (size_t i = 0; i < args.size(); ++i) {
+        StringRef arg = args[i];
+        if (arg == "-include-pch") {
+            ++i;
+            continue;
+        }
+        if (arg.startswith("-include") || arg.startswith("-imacros")) {
+            // Both flags have the same length.
+            auto file = arg.drop_front(StringRef("-include").size());
+            if (file.empty() && i + 1 < args.size()) {
+                file = args[++i];
+            }
+            forcedFiles.push_back(file);
+            continue;
+        }
+
+        for (StringRef flag : { "-iquote", "-I", "-isystem", "-idirafter" }) {
+            if (!arg.startswith(flag)) { continue; }
+
+            SmallString<256> directory(arg.drop_front(flag.size()));
+            if (directory.empty() && i + 1 < args.size()) {
+                directory = args[++i];
+            }
+            makeAbsolute(Command.Directory, directory);
+
+            (flag == "-iquote" ? quotedDirectories : directories).push_back(directory.str());
+            break;
+        }
+    }
+
+    auto resolve = [&](const Include &Inc, StringRef IncluderDirectory) -> std::string {
+        SmallString<256> candidate;
+        auto tryDirectory = [&](StringRef Directory) {
+            candidate = Directory;
+            sys::path::append(candidate, Inc.Spelling);
+            sys::path::remove_dots(candidate);
+            return scan(candidate).Exists;
+        };
+
+        if (!Inc.IsAngled) {
+            if (tryDirectory(IncluderDirectory)) { return candidate.str(); }
+            for (const auto &directory : quotedDirectories) {
+                if (tryDirectory(directory)) { return candidate.str(); }
+            }
+        }
+        for (const auto &directory : directories) {
+            if (tryDirectory(directory)) { return candidate.str(); }
+        }
+        return {};
+    };
+
+    SmallString<256> mainFile(Command.Filename);
+    makeAbsolute(Command.Directory, mainFile);
+
+    std::vector<std::string> worklist{ mainFile.str() };
+    StringSet<> visited;
+    uint64_t found = 0;
+
+    // Clang looks forced includes up from the working directory first, then
+    // like a quoted include. One that cannot be found keeps the unit.
+    for (const auto &file : forcedFiles) {
+        SmallString<256> path(file);
+        makeAbsolute(Command.Directory, path);
+        if (scan(path).Exists) {
+            worklist.push_back(path.str());
+            continue;
+        }
+
+        auto resolved = resolve({ file, /*IsAngled=*/false }, Command.Directory);
+        if (resolved.empty()) { return true; }
+        worklist.push_back(std::move(resolved));
+    }
+
+    while (!worklist.empty()) {
+        auto path = std::move(worklist.back());
+        worklist.pop_back();
+        if (!visited.insert(path).second) { continue; }
+
+        const auto &fileScan = scan(path);
+        if (!fileScan.Exists) {
+            // Let clang report a missing main file.
+            if (path == mainFile) { return true; }
+            continue;
+        }
+
+        found |= fileScan.Found;
+        if (found == AllFound || fileScan.HasMacroInclude) { return true; }
+
+        auto includerDirectory = sys::path::parent_path(path);
+        for (const auto &include : fileScan.Includes) {
+            auto resolved = resolve(include, includerDirectory);
+            if (resolved.empty()) {
+                if (!include.IsAngled) { return true; }
+                continue;
+            }
+            worklist.push_back(std::move(resolved));
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "clang/Tooling/CompilationDatabase.h"
+
+#include "llvm/ADT/StringMap.h"
+
+#include <string>
+#include <vector>
+
+// Returns true if Identifier occurs in Text as a whole identifier, i.e. not as
+// part of a longer one. Uses AVX2 or SSE2 when the CPU has them.
+bool containsIdentifier(llvm::StringRef Text, llvm::StringRef Identifier);
+
+// Drops translation units that cannot match before clang is started. A
+// translation unit is kept only if every required identifier appears in its
+// source file or in a header it includes, directly or transitively.
+//
+// Includes are found textually, without evaluating the preprocessor, and
+// resolved against the command's include directories. Angle includes that do
+// not resolve are taken to be system headers and ignored; a quoted or macro
+// include that does not resolve keeps the translation unit. Files forced in
+// with -include or -imacros are scanned as well and must resolve too.
+class LexicalPrefilter {
+    struct Include {
+        std::string Spelling;
+        bool IsAngled;
+    };
+
+    struct FileScan {
+        bool Exists = false;
+        uint64_t Found = 0;
+        bool HasMacroInclude = false;
+        std::vector<Include> Includes;
+    };
+
+    std::vector<std::string> Identifiers;
+    uint64_t AllFound;
+    llvm::StringMap<FileScan> Scans;
+
+public:
+    static constexpr unsigned MaxIdentifiers = 64;
+
+    explicit LexicalPrefilter(std::vector<std::string> Identifiers);
+
+    bool mayMatch(const clang::tooling::CompileCommand &Command);
+
+private:
+    const FileScan &scan(llvm::StringRef Path);
+    static void collectIncludes(llvm::StringRef Text, FileScan &Scan);
+};
@@ -0,0 +1,77 @@
+// Builds the visitor written by the codegen subcommand into the tool when
+// configured with -DCOMPILED_QUERIES=<header>. Without one the analysis is
+// compiled against an empty stand-in but not registered.
+#include "analyses/Analysis.h"
+
+#ifdef COMPILED_QUERIES
+#include COMPILED_QUERIES
+#else
+#include "queries/NoCompiledQueries.h"
+#endif
+
+#include "clang/Basic/SourceManager.h"
+
+using namespace clang;
+using namespace llvm;
+
+namespace {
+
+// Same output as --query-file, from a fixed traversal instead of matchers.
+// The traversal covers the whole translation unit, so it does not honour the
+// traversal scope options.
+class CompiledQueryAnalysis : public Analysis {
+    std::string Output;
+
+    class Consumer : public ASTConsumer {
+        std::string &Output;
+
+    public:
+        explicit Consumer(std::string &Output) : Output(Output) {}
+
+        void HandleTranslationUnit(ASTContext &Context) override {
+            const auto &sourceManager = Context.getSourceManager();
+            raw_string_ostream OS(Output);
+
+            auto report = [&](unsigned Query, const Decl *D) {
+                auto location = sourceManager.getPresumedLoc(
+                    sourceManager.getSpellingLoc(D->getLocStart()));
+                OS << "match\t" << compiled_queries::Labels[Query] << "\t"
+                   << D->getDeclKindName() << "Decl\t";
+                if (location.isValid()) {
+                    OS << location.getFilename() << ":" << location.getLine() << ":"
+                       << location.getColumn();
+                } else {
+                    OS << "<invalid>";
+                }
+                OS << "\n";
+            };
+
+            compiled_queries::Visitor<decltype(report)> visitor(Context, report);
+            visitor.TraverseDecl(Context.getTranslationUnitDecl());
+        }
+    };
+
+public:
+    std::unique_ptr<ASTConsumer> createASTConsumer(CompilerInstance &CI) override {
+        return llvm::make_unique<Consumer>(Output);
+    }
+
+    bool usesASTConsumer() const override { return true; }
+
+    bool needsSerialMatching() const override { return true; }
+
+    void print(raw_ostream &OS) const override {
+        OS << Output;
+    }
+
+    void merge(StringRef Printed) override {
+        Output += Printed;
+    }
+};
+
+}
+
+#ifdef COMPILED_QUERIES
+static AnalysisRegistry::Add<CompiledQueryAnalysis>
+    X("compiled-queries", "queries compiled in from a codegen header");
+#endif
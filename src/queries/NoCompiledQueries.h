@@ -0,0 +1,21 @@
+// Stands in for a codegen header when none is configured, so the
+// compiled-queries analysis is still compiled in every build. It matches
+// nothing and the analysis is not registered.
+#pragma once
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+
+namespace compiled_queries {
+
+static const char *const Labels[] = {
+    "",
+};
+
+template <typename Report>
+class Visitor : public clang::RecursiveASTVisitor<Visitor<Report>> {
+public:
+    Visitor(clang::ASTContext &Context, Report &Found) {}
+};
+
+}
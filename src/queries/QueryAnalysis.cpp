@@ -0,0 +1,47 @@
+#include "QueryAnalysis.h"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/Basic/SourceManager.h"
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace llvm;
+
+QueryAnalysis::QueryAnalysis(ArrayRef<Query> Queries, MatcherCache &Cache) : Cache(Cache) {
+    for (const auto &query : Queries) {
+        auto &batch = Batches[MatcherCache::getKey(query.Source)];
+        batch.Source = query.Source;
+        batch.Labels.push_back(query.Label);
+        batch.Output = &Output;
+    }
+}
+
+void QueryAnalysis::addMatchers(MatcherList &Matchers) {
+    for (auto &batch : Batches) {
+        std::string errorMessage;
+        if (const auto *matcher = Cache.get(batch.second.Source, errorMessage)) {
+            Matchers.add(*matcher, &batch.second);
+        }
+    }
+}
+
+void QueryAnalysis::Batch::run(const MatchFinder::MatchResult &Result) {
+    const auto &nodes = Result.Nodes.getMap();
+    auto root = nodes.find("root");
+    if (root == nodes.end()) { return; }
+
+    const auto &sourceManager = *Result.SourceManager;
+    auto location = sourceManager.getPresumedLoc(
+        sourceManager.getSpellingLoc(root->second.getSourceRange().getBegin()));
+
+    raw_string_ostream OS(*Output);
+    for (const auto &label : Labels) {
+        OS << "match\t" << label << "\t" << root->second.getNodeKind().asStringRef() << "\t";
+        if (location.isValid()) {
+            OS << location.getFilename() << ":" << location.getLine() << ":" << location.getColumn();
+        } else {
+            OS << "<invalid>";
+        }
+        OS << "\n";
+    }
+}
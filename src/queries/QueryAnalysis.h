@@ -0,0 +1,41 @@
+#pragma once
+
+#include "analyses/Analysis.h"
+#include "queries/QueryFile.h"
+
+#include <map>
+
+// Runs every loaded query in the same traversal as the other analyses.
+// Identical queries share one matcher and are reported under each label:
+//   match  <query label>  <node kind>  <file>:<line>:<column>
+class QueryAnalysis : public Analysis {
+    struct Batch : public clang::ast_matchers::MatchFinder::MatchCallback {
+        std::string Source;
+        std::vector<std::string> Labels;
+        std::string *Output = nullptr;
+
+        void run(const clang::ast_matchers::MatchFinder::MatchResult &Result) override;
+    };
+
+    MatcherCache &Cache;
+    // Keyed by MatcherCache::getKey, ordered so output is reproducible.
+    std::map<std::string, Batch> Batches;
+    std::string Output;
+
+public:
+    // Every query must already compile in Cache.
+    QueryAnalysis(llvm::ArrayRef<Query> Queries, MatcherCache &Cache);
+
+    void addMatchers(MatcherList &Matchers) override;
+
+    // Queries may use any narrowing matcher, including those on locations.
+    bool needsSerialMatching() const override { return true; }
+
+    void print(llvm::raw_ostream &OS) const override {
+        OS << Output;
+    }
+
+    void merge(llvm::StringRef Printed) override {
+        Output += Printed;
+    }
+};
@@ -0,0 +1,402 @@
+#include "QueryCodegen.h"
+
+#include "support/BinaryFile.h"
+
+#include "clang/ASTMatchers/Dynamic/Parser.h"
+#include "clang/Basic/CharInfo.h"
+#include "llvm/ADT/STLExtras.h"
+
+#include <map>
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace llvm;
+
+namespace {
+
+// A parsed matcher expression: a call with arguments, or a literal.
+struct Expression {
+    std::string Name;
+    std::vector<Expression> Arguments;
+    enum { Call, String, Number } Kind = Call;
+    std::string Value;
+};
+
+// The dynamic parser has already accepted the text, so this only needs to
+// recover its structure.
+class ExpressionParser {
+    StringRef Text;
+
+    void skipSpace() { Text = Text.ltrim(); }
+
+    bool consume(char C) {
+        skipSpace();
+        if (Text.empty() || Text.front() != C) { return false; }
+        Text = Text.drop_front();
+        return true;
+    }
+
+    bool parseString(std::string &Value) {
+        Text = Text.drop_front();
+        while (!Text.empty() && Text.front() != '"') {
+            if (Text.front() == '\\' && Text.size() > 1) { Text = Text.drop_front(); }
+            Value += Text.front();
+            Text = Text.drop_front();
+        }
+        return consume('"');
+    }
+
+public:
+    explicit ExpressionParser(StringRef Text) : Text(Text) {}
+
+    bool parse(Expression &Result) {
+        skipSpace();
+        if (Text.empty()) { return false; }
+
+        if (Text.front() == '"') {
+            Result.Kind = Expression::String;
+            return parseString(Result.Value);
+        }
+
+        if (isDigit(Text.front())) {
+            Result.Kind = Expression::Number;
+            auto size = Text.find_if([](char C) { return !isDigit(C); });
+            Result.Value = Text.take_front(size);
+            Text = Text.drop_front(size);
+            return true;
+        }
+
+        auto size = Text.find_if([](char C) { return !isIdentifierBody(C); });
+        Result.Name = Text.take_front(size);
+        Text = Text.drop_front(size);
+        if (Result.Name.empty() || !consume('(')) { return false; }
+
+        if (!consume(')')) {
+            do {
+                Result.Arguments.emplace_back();
+                if (!parse(Result.Arguments.back())) { return false; }
+            } while (consume(','));
+            if (!consume(')')) { return false; }
+        }
+
+        // Bindings have no meaning in a generated visitor.
+        skipSpace();
+        if (Text.startswith(".bind")) {
+            Text = Text.drop_front(5);
+            Expression id;
+            return consume('(') && parse(id) && id.Kind == Expression::String && consume(')');
+        }
+        return true;
+    }
+
+    bool atEnd() {
+        skipSpace();
+        return Text.empty();
+    }
+};
+
+}
+
+// The clang classes a generated predicate can be evaluated on, with the node
+// matcher that names each one.
+static const struct {
+    const char *Matcher;
+    const char *Class;
+    const char *Base;
+} NodeClasses[] = {
+    { "decl", "Decl", nullptr },
+    { "namedDecl", "NamedDecl", "Decl" },
+    { nullptr, "TypeDecl", "NamedDecl" },
+    { "tagDecl", "TagDecl", "TypeDecl" },
+    { "recordDecl", "RecordDecl", "TagDecl" },
+    { "cxxRecordDecl", "CXXRecordDecl", "RecordDecl" },
+    { "enumDecl", "EnumDecl", "TagDecl" },
+    { "valueDecl", "ValueDecl", "NamedDecl" },
+    { "enumConstantDecl", "EnumConstantDecl", "ValueDecl" },
+    { "declaratorDecl", "DeclaratorDecl", "ValueDecl" },
+    { "fieldDecl", "FieldDecl", "DeclaratorDecl" },
+    { "varDecl", "VarDecl", "DeclaratorDecl" },
+    { "functionDecl", "FunctionDecl", "DeclaratorDecl" },
+    { "cxxMethodDecl", "CXXMethodDecl", "FunctionDecl" },
+    { "namespaceDecl", "NamespaceDecl", "NamedDecl" },
+};
+
+// Narrowing matchers and the C++ they inline to. $N is the node, $A the
+// argument. A matcher listed for several classes uses the first entry the
+// node derives from.
+enum PredicateArgument { NoArgument, StringArgument, NumberArgument };
+
+static const struct {
+    const char *Matcher;
+    const char *Class;
+    PredicateArgument Argument;
+    const char *Code;
+} Predicates[] = {
+    { "hasName", "NamedDecl", StringArgument, "compiled_queries::hasName(*$N, $A)" },
+    { "isDefinition", "TagDecl", NoArgument, "$N->isThisDeclarationADefinition()" },
+    { "isDefinition", "FunctionDecl", NoArgument, "$N->isThisDeclarationADefinition()" },
+    { "isDefinition", "VarDecl", NoArgument,
+      "$N->isThisDeclarationADefinition() == clang::VarDecl::Definition" },
+    { "isImplicit", "Decl", NoArgument, "$N->isImplicit()" },
+    { "isPublic", "Decl", NoArgument, "$N->getAccess() == clang::AS_public" },
+    { "isProtected", "Decl", NoArgument, "$N->getAccess() == clang::AS_protected" },
+    { "isPrivate", "Decl", NoArgument, "$N->getAccess() == clang::AS_private" },
+    { "isExpansionInMainFile", "Decl", NoArgument,
+      "SM.isInMainFile(SM.getExpansionLoc($N->getLocStart()))" },
+    { "isExpansionInSystemHeader", "Decl", NoArgument,
+      "SM.isInSystemHeader(SM.getExpansionLoc($N->getLocStart()))" },
+    { "isStruct", "TagDecl", NoArgument, "$N->isStruct()" },
+    { "isClass", "TagDecl", NoArgument, "$N->isClass()" },
+    { "isUnion", "TagDecl", NoArgument, "$N->isUnion()" },
+    { "isConst", "CXXMethodDecl", NoArgument, "$N->isConst()" },
+    { "isVirtual", "CXXMethodDecl", NoArgument, "$N->isVirtual()" },
+    { "isPure", "CXXMethodDecl", NoArgument, "$N->isPure()" },
+    { "isStaticStorageClass", "FunctionDecl", NoArgument,
+      "$N->getStorageClass() == clang::SC_Static" },
+    { "isStaticStorageClass", "VarDecl", NoArgument,
+      "$N->getStorageClass() == clang::SC_Static" },
+    { "parameterCountIs", "FunctionDecl", NumberArgument, "$N->getNumParams() == $A" },
+};
+
+static const char *getNodeClass(StringRef Matcher) {
+    for (const auto &node : NodeClasses) {
+        if (node.Matcher && Matcher == node.Matcher) { return node.Class; }
+    }
+    return nullptr;
+}
+
+static bool isDerivedFrom(StringRef Class, StringRef Base) {
+    while (!Class.empty()) {
+        if (Class == Base) { return true; }
+
+        const char *parent = nullptr;
+        for (const auto &node : NodeClasses) {
+            if (Class == node.Class) { parent = node.Base; }
+        }
+        Class = parent ? parent : "";
+    }
+    return false;
+}
+
+static std::string quote(StringRef Value) {
+    std::string quoted = "\"";
+    for (auto c : Value) {
+        if (c == '"' || c == '\\') { quoted += '\\'; }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// Inlines Expr as a C++ condition on Node, an expression of type Class *.
+static bool compilePredicate(const Expression &Expr, StringRef Class, StringRef Node,
+                             std::string &Code, std::string &ErrorMessage);
+
+static bool compileAll(ArrayRef<Expression> Exprs, StringRef Class, StringRef Node,
+                       StringRef Separator, std::string &Code, std::string &ErrorMessage) {
+    if (Exprs.empty()) {
+        Code = "true";
+        return true;
+    }
+
+    Code.clear();
+    for (const auto &expr : Exprs) {
+        std::string inner;
+        if (!compilePredicate(expr, Class, Node, inner, ErrorMessage)) { return false; }
+        if (!Code.empty()) { Code += Separator; }
+        Code += "(" + inner + ")";
+    }
+    return true;
+}
+
+static bool compilePredicate(const Expression &Expr, StringRef Class, StringRef Node,
+                             std::string &Code, std::string &ErrorMessage) {
+    if (Expr.Kind != Expression::Call) {
+        ErrorMessage = "unexpected literal where a matcher was expected";
+        return false;
+    }
+
+    if (Expr.Name == "allOf") {
+        return compileAll(Expr.Arguments, Class, Node, " && ", Code, ErrorMessage);
+    }
+    if (Expr.Name == "anyOf") {
+        return compileAll(Expr.Arguments, Class, Node, " || ", Code, ErrorMessage);
+    }
+    if (Expr.Name == "unless" && Expr.Arguments.size() == 1) {
+        if (!compilePredicate(Expr.Arguments[0], Class, Node, Code, ErrorMessage)) { return false; }
+        Code = "!(" + Code + ")";
+        return true;
+    }
+
+    if (Expr.Name == "ofClass" && Expr.Arguments.size() == 1 &&
+        isDerivedFrom(Class, "CXXMethodDecl")) {
+        return compilePredicate(Expr.Arguments[0], "CXXRecordDecl",
+                                (Node + "->getParent()").str(), Code, ErrorMessage);
+    }
+
+    // A node matcher nested in a predicate narrows the node's class.
+    if (const auto *target = getNodeClass(Expr.Name)) {
+        if (isDerivedFrom(Class, target)) {
+            return compileAll(Expr.Arguments, Class, Node, " && ", Code, ErrorMessage);
+        }
+        if (!isDerivedFrom(target, Class)) {
+            ErrorMessage = Expr.Name + " can never match a " + Class.str();
+            return false;
+        }
+
+        auto cast = ("llvm::cast<clang::" + Twine(target) + ">(" + Node + ")").str();
+        if (!compileAll(Expr.Arguments, target, cast, " && ", Code, ErrorMessage)) { return false; }
+        Code = ("llvm::isa<clang::" + Twine(target) + ">(" + Node + ") && (" + Code + ")").str();
+        return true;
+    }
+
+    for (const auto &predicate : Predicates) {
+        if (Expr.Name != predicate.Matcher || !isDerivedFrom(Class, predicate.Class)) { continue; }
+
+        std::string argument;
+        if (predicate.Argument == NoArgument) {
+            if (!Expr.Arguments.empty()) { break; }
+        } else {
+            auto kind = predicate.Argument == StringArgument ? Expression::String : Expression::Number;
+            if (Expr.Arguments.size() != 1 || Expr.Arguments[0].Kind != kind) { break; }
+            argument = kind == Expression::String ? quote(Expr.Arguments[0].Value)
+                                                  : Expr.Arguments[0].Value + "u";
+        }
+
+        Code = predicate.Code;
+        for (size_t at; (at = Code.find("$N")) != std::string::npos;) {
+            Code.replace(at, 2, Node);
+        }
+        for (size_t at; (at = Code.find("$A")) != std::string::npos;) {
+            Code.replace(at, 2, argument);
+        }
+        return true;
+    }
+
+    ErrorMessage = Expr.Name + " is not supported on " + Class.str() +
+                   " ahead of time, keep the query in a --query-file";
+    return false;
+}
+
+bool generateQueryVisitor(ArrayRef<Query> Queries, raw_ostream &OS, std::string &ErrorMessage) {
+    // Visit method bodies per class, in query order.
+    std::map<std::string, std::string> visits;
+
+    for (size_t i = 0; i < Queries.size(); ++i) {
+        const auto &query = Queries[i];
+
+        dynamic::Diagnostics diagnostics;
+        if (!dynamic::Parser::parseMatcherExpression(query.Source, &diagnostics)) {
+            ErrorMessage = query.Label + ": " + diagnostics.toStringFull();
+            return false;
+        }
+
+        Expression expr;
+        ExpressionParser parser(query.Source);
+        const char *nodeClass = nullptr;
+        if (!parser.parse(expr) || !parser.atEnd() || !(nodeClass = getNodeClass(expr.Name))) {
+            ErrorMessage = query.Label + ": only declaration matchers can be compiled ahead of time";
+            return false;
+        }
+
+        std::string condition;
+        if (!compileAll(expr.Arguments, nodeClass, "N", " && ", condition, ErrorMessage)) {
+            ErrorMessage = query.Label + ": " + ErrorMessage;
+            return false;
+        }
+
+        raw_string_ostream body(visits[nodeClass]);
+        body << "        // " << query.Label << "\n"
+             << "        if (" << condition << ") { Found(" << i << "u, N); }\n";
+    }
+
+    OS << "// Generated by the codegen subcommand, regenerate instead of editing.\n"
+       << "#pragma once\n"
+       << "\n"
+       << "#include \"clang/AST/ASTContext.h\"\n"
+       << "#include \"clang/AST/RecursiveASTVisitor.h\"\n"
+       << "\n"
+       << "namespace compiled_queries {\n"
+       << "\n"
+       << "static const char *const Labels[] = {\n";
+    for (const auto &query : Queries) {
+        OS << "    " << quote(query.Label) << ",\n";
+    }
+    OS << "};\n"
+       << "\n"
+       << "// Same rules as the hasName matcher.\n"
+       << "inline bool hasName(const clang::NamedDecl &N, llvm::StringRef Name) {\n"
+       << "    if (!Name.contains(\"::\")) {\n"
+       << "        auto *identifier = N.getIdentifier();\n"
+       << "        return identifier ? identifier->getName() == Name : N.getNameAsString() == Name;\n"
+       << "    }\n"
+       << "    auto qualified = N.getQualifiedNameAsString();\n"
+       << "    if (Name.startswith(\"::\")) { return qualified == Name.drop_front(2); }\n"
+       << "    return qualified == Name || llvm::StringRef(qualified).endswith((\"::\" + Name).str());\n"
+       << "}\n"
+       << "\n"
+       << "template <typename Report>\n"
+       << "class Visitor : public clang::RecursiveASTVisitor<Visitor<Report>> {\n"
+       << "    const clang::SourceManager &SM;\n"
+       << "    Report &Found;\n"
+       << "\n"
+       << "public:\n"
+       << "    Visitor(clang::ASTContext &Context, Report &Found)\n"
+       << "        : SM(Context.getSourceManager()), Found(Found) {}\n"
+       << "\n"
+       << "    // Visit what MatchFinder visits.\n"
+       << "    bool shouldVisitTemplateInstantiations() const { return true; }\n"
+       << "    bool shouldVisitImplicitCode() const { return true; }\n";
+
+    for (const auto &visit : visits) {
+        OS << "\n"
+           << "    bool Visit" << visit.first << "(clang::" << visit.first << " *N) {\n"
+           << visit.second
+           << "        return true;\n"
+           << "    }\n";
+    }
+
+    OS << "};\n"
+       << "\n"
+       << "}\n";
+
+    return true;
+}
+
+int runCodegenCommand(int argc, const char **argv) {
+    std::string outputPath;
+    std::vector<Query> queries;
+
+    for (int i = 1; i < argc; ++i) {
+        StringRef arg(argv[i]);
+        if (arg.consume_front("--codegen-output=")) {
+            outputPath = arg;
+            continue;
+        }
+
+        std::string errorMessage;
+        if (!loadQueryFile(arg, queries, errorMessage)) {
+            errs() << "error: " << errorMessage << "\n";
+            return 1;
+        }
+    }
+
+    if (outputPath.empty() || queries.empty()) {
+        errs() << "error: codegen requires --codegen-output=<header> and a query file\n";
+        return 1;
+    }
+
+    std::string header;
+    std::string errorMessage;
+    raw_string_ostream OS(header);
+    if (!generateQueryVisitor(queries, OS, errorMessage)) {
+        errs() << "error: " << errorMessage << "\n";
+        return 1;
+    }
+
+    if (auto ec = writeFileAtomically(outputPath, OS.str())) {
+        errs() << "error: cannot write " << outputPath << ": " << ec.message() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "queries/QueryFile.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+// Translates queries into a header declaring
+//
+//   template <typename Report> class compiled_queries::Visitor
+//
+// a RecursiveASTVisitor with each query's narrowing predicates inlined into
+// the Visit method of its node class. Report is called as
+// Report(unsigned QueryIndex, const clang::Decl *D) for every match.
+//
+// Only declaration matchers and a fixed set of narrowing matchers are
+// supported. Returns false with ErrorMessage naming the first query that
+// cannot be compiled.
+bool generateQueryVisitor(llvm::ArrayRef<Query> Queries, llvm::raw_ostream &OS,
+                          std::string &ErrorMessage);
+
+// The "codegen" subcommand:
+//
+//   ExecutableName codegen --codegen-output=<header> <query file>...
+//
+// Configure with -DCOMPILED_QUERIES=<header> to build the visitor into the
+// tool as the "compiled-queries" analysis.
+int runCodegenCommand(int argc, const char **argv);
@@ -0,0 +1,82 @@
+#include "QueryFile.h"
+
+#include "clang/ASTMatchers/Dynamic/Parser.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+using namespace clang::ast_matchers;
+using namespace llvm;
+
+bool loadQueryFile(StringRef Path, std::vector<Query> &Queries, std::string &ErrorMessage) {
+    auto buffer = MemoryBuffer::getFile(Path);
+    if (!buffer) {
+        ErrorMessage = "cannot read " + Path.str() + ": " + buffer.getError().message();
+        return false;
+    }
+
+    Query current;
+    auto flush = [&] {
+        if (!StringRef(current.Source).trim().empty()) {
+            Queries.push_back(std::move(current));
+        }
+        current = Query();
+    };
+
+    StringRef text = (*buffer)->getBuffer();
+    for (unsigned lineNumber = 1; !text.empty(); ++lineNumber) {
+        StringRef line;
+        std::tie(line, text) = text.split('\n');
+        line = line.trim();
+
+        if (line.empty()) {
+            flush();
+            continue;
+        }
+        if (line.startswith("#")) { continue; }
+
+        if (current.Source.empty()) {
+            current.Label = (Path + ":" + Twine(lineNumber)).str();
+            if (line.startswith("match ") || line.startswith("m ")) {
+                line = line.split(' ').second.ltrim();
+            }
+        }
+        current.Source += line;
+        current.Source += '\n';
+    }
+    flush();
+
+    return true;
+}
+
+std::string MatcherCache::getKey(StringRef Source) {
+    MD5 hash;
+    hash.update(Source.trim());
+    MD5::MD5Result result;
+    hash.final(result);
+
+    SmallString<32> key;
+    MD5::stringifyResult(result, key);
+    return key.str();
+}
+
+const internal::DynTypedMatcher *MatcherCache::get(StringRef Source, std::string &ErrorMessage) {
+    auto key = getKey(Source);
+
+    auto found = Matchers.find(key);
+    if (found != Matchers.end()) { return &found->second; }
+
+    dynamic::Diagnostics diagnostics;
+    auto matcher = dynamic::Parser::parseMatcherExpression(Source, &diagnostics);
+    if (!matcher) {
+        ErrorMessage = diagnostics.toStringFull();
+        return nullptr;
+    }
+
+    auto bound = matcher->tryBind("root");
+    if (!bound) {
+        ErrorMessage = "query does not match a node that can be bound";
+        return nullptr;
+    }
+
+    return &Matchers.insert(std::make_pair(key, *bound)).first->second;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "clang/ASTMatchers/ASTMatchersInternal.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <string>
+#include <vector>
+
+// One matcher expression from a query file, e.g.
+//   cxxRecordDecl(isDefinition(), hasName("Widget"))
+struct Query {
+    // <file>:<line> of the first line of the expression.
+    std::string Label;
+    std::string Source;
+};
+
+// Reads the queries in Path. Expressions are separated by blank lines, may
+// span several lines and may start with clang-query's "match" command.
+// Lines starting with '#' are comments.
+bool loadQueryFile(llvm::StringRef Path, std::vector<Query> &Queries, std::string &ErrorMessage);
+
+// Compiled matchers keyed by the MD5 of their source, so a query repeated
+// across files or runs is only parsed once. Filled before the fork-server
+// starts, its children inherit every compiled matcher.
+class MatcherCache {
+    llvm::StringMap<clang::ast_matchers::internal::DynTypedMatcher> Matchers;
+
+public:
+    static std::string getKey(llvm::StringRef Source);
+
+    // The matcher for Source bound to "root", or null with ErrorMessage set.
+    const clang::ast_matchers::internal::DynTypedMatcher *get(llvm::StringRef Source,
+                                                              std::string &ErrorMessage);
+};
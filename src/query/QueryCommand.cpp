@@ -0,0 +1,110 @@
+#include "QueryCommand.h"
+
+#include "query/ResultStore.h"
+#include "results/ScanResults.h"
+
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+static int printMatches(StringRef StorePath, const SymbolFilter &Filter) {
+    std::string errorMessage;
+    auto store = ResultStore::load(StorePath, errorMessage);
+    if (!store) {
+        errs() << "error: " << errorMessage << "\n";
+        return 1;
+    }
+
+    for (auto symbol : store->find(Filter)) {
+        outs() << (store->getKind(symbol) == ResultStore::Class ? "class" : "method") << "\t"
+               << store->getName(symbol) << "\t" << store->getDetail(symbol) << "\n";
+    }
+    return 0;
+}
+
+int runQueryCommand(int argc, const char **argv) {
+    std::string storePath;
+    SymbolFilter filter;
+    bool hasFilter = false;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        StringRef arg(argv[i]);
+        if (arg.consume_front("--store=")) {
+            storePath = arg;
+            continue;
+        }
+        if (!arg.startswith("--")) {
+            inputs.push_back(arg);
+            continue;
+        }
+
+        hasFilter = true;
+        if (arg.consume_front("--name=")) {
+            filter.Name = arg;
+        } else if (arg.consume_front("--namespace=")) {
+            filter.Namespace = arg;
+        } else if (arg == "--const") {
+            filter.OnlyConst = true;
+        } else if (arg.consume_front("--returns=")) {
+            filter.Returns = StringSwitch<SymbolFilter::ReturnCategory>(arg)
+                                 .Case("void", SymbolFilter::ReturnsVoid)
+                                 .Case("value", SymbolFilter::ReturnsValue)
+                                 .Case("pointer", SymbolFilter::ReturnsPointer)
+                                 .Case("reference", SymbolFilter::ReturnsReference)
+                                 .Default(SymbolFilter::AnyReturn);
+            if (filter.Returns == SymbolFilter::AnyReturn) {
+                errs() << "error: --returns must be void, value, pointer or reference\n";
+                return 1;
+            }
+        } else if (arg.consume_front("--min-params=")) {
+            if (arg.getAsInteger(10, filter.MinParameters) || filter.MinParameters < 0) {
+                errs() << "error: --min-params requires a count\n";
+                return 1;
+            }
+        } else if (arg.consume_front("--max-params=")) {
+            if (arg.getAsInteger(10, filter.MaxParameters) || filter.MaxParameters < 0) {
+                errs() << "error: --max-params requires a count\n";
+                return 1;
+            }
+        } else {
+            errs() << "error: unknown query option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (storePath.empty()) {
+        errs() << "error: query requires --store=<file>\n";
+        return 1;
+    }
+
+    if (inputs.empty()) {
+        if (!hasFilter) {
+            errs() << "error: query requires scan results to store or a filter\n";
+            return 1;
+        }
+        return printMatches(storePath, filter);
+    }
+
+    ScanResults results;
+    for (const auto &input : inputs) {
+        auto buffer = MemoryBuffer::getFile(input);
+        ScanResults parsed;
+        if (!buffer || !parsed.parse((*buffer)->getBuffer())) {
+            errs() << "error: cannot read " << input << "\n";
+            return 1;
+        }
+        for (auto &record : parsed.Classes) {
+            results.Classes.push_back(std::move(record));
+        }
+    }
+
+    if (auto ec = writeResultStore(storePath, results)) {
+        errs() << "error: cannot write " << storePath << ": " << ec.message() << "\n";
+        return 1;
+    }
+
+    return hasFilter ? printMatches(storePath, filter) : 0;
+}
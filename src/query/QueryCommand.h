@@ -0,0 +1,11 @@
+#pragma once
+
+// The "query" subcommand. With scan result files (.scan sidecars or merge
+// output) it stores them into the file named by --store. Filters print the
+// symbols of that store matching all of them:
+//   --name=<substring>     qualified name contains it, ignoring case
+//   --namespace=<name>     declared inside the namespace or class
+//   --returns=<category>   void, value, pointer or reference
+//   --min-params=<count>, --max-params=<count>
+//   --const
+int runQueryCommand(int argc, const char **argv);
@@ -0,0 +1,302 @@
+#include "ResultStore.h"
+
+#include "query/TrigramIndex.h"
+#include "support/BinaryFile.h"
+
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+namespace {
+
+constexpr char Magic[] = { 'C', 'T', 'S', 'T', 'O', 'R', 'E', 0 };
+constexpr uint32_t Version = 2;
+
+enum : uint32_t {
+    VersionOffset = 8,
+    SymbolCountOffset = 12,
+    NamesOffset = 16,
+    DetailsOffset = 20,
+    BitmapsOffset = 24,
+    AritiesOffset = 28,
+    KindsOffset = 32,
+    TrigramsOffset = 36,
+    TrigramEntriesOffset = 40,
+    TrigramsSizeOffset = 44,
+    StringsOffset = 48,
+    StringsSizeOffset = 52,
+    HeaderSize = 56
+};
+
+// Bitmaps in file order. The return categories share their numbers with
+// SymbolFilter::ReturnCategory.
+enum Bitmap : uint32_t { ConstBitmap, VoidBitmap, ValueBitmap, PointerBitmap, ReferenceBitmap,
+                         BitmapCount };
+
+struct StoredSymbol {
+    std::string Name;
+    ResultStore::SymbolKind Kind;
+    std::string Detail;
+    uint8_t Arity;
+    uint8_t Bits;
+};
+
+uint32_t getBitmapWords(uint32_t Symbols) {
+    return (Symbols + 63) / 64;
+}
+
+Bitmap getReturnCategory(StringRef ReturnType) {
+    ReturnType = ReturnType.rtrim();
+    if (ReturnType.endswith("*")) { return PointerBitmap; }
+    if (ReturnType.endswith("&")) { return ReferenceBitmap; }
+    if (ReturnType == "void") { return VoidBitmap; }
+    return ValueBitmap;
+}
+
+} // namespace
+
+static std::string getSignature(const MethodRecord &Method) {
+    std::string signature = Method.ReturnType + " " + Method.Name + "(";
+    for (size_t i = 0; i < Method.ParameterTypes.size(); ++i) {
+        if (i) { signature += ", "; }
+        signature += Method.ParameterTypes[i];
+    }
+    signature += ")";
+    if (Method.IsConst) { signature += " const"; }
+    return signature;
+}
+
+std::error_code writeResultStore(StringRef Path, const ScanResults &Results) {
+    std::vector<StoredSymbol> symbols;
+    StringSet<> seen;
+    for (const auto &record : Results.Classes) {
+        if (!seen.insert(record.QualifiedName).second) { continue; }
+
+        symbols.push_back({ record.QualifiedName, ResultStore::Class, record.File, 0, 0 });
+        for (const auto &method : record.Methods) {
+            uint8_t bits = 1 << getReturnCategory(method.ReturnType);
+            if (method.IsConst) { bits |= 1 << ConstBitmap; }
+            auto arity = std::min<size_t>(method.ParameterTypes.size(), 255);
+
+            symbols.push_back({ record.QualifiedName + "::" + method.Name, ResultStore::Method,
+                                getSignature(method), static_cast<uint8_t>(arity), bits });
+        }
+    }
+    std::stable_sort(symbols.begin(), symbols.end(),
+                     [](const StoredSymbol &Left, const StoredSymbol &Right) {
+                         return Left.Name < Right.Name;
+                     });
+
+    StringPoolBuilder strings;
+    BinaryWriter names;
+    BinaryWriter details;
+    BinaryWriter arities;
+    BinaryWriter kinds;
+    std::vector<uint64_t> bitmaps(BitmapCount * getBitmapWords(symbols.size()));
+    std::vector<StringRef> nameList;
+    for (uint32_t number = 0; number < symbols.size(); ++number) {
+        const auto &symbol = symbols[number];
+        names.write32(strings.add(symbol.Name));
+        details.write32(strings.add(symbol.Detail));
+        arities.write8(symbol.Arity);
+        kinds.write8(symbol.Kind);
+        for (uint32_t bitmap = 0; bitmap < BitmapCount; ++bitmap) {
+            if (symbol.Bits & (1 << bitmap)) {
+                bitmaps[bitmap * getBitmapWords(symbols.size()) + number / 64] |=
+                    uint64_t(1) << (number % 64);
+            }
+        }
+        nameList.push_back(symbol.Name);
+    }
+
+    BinaryWriter file;
+    file.writeBytes(StringRef(Magic, sizeof(Magic)));
+    while (file.size() < HeaderSize) {
+        file.write32(0);
+    }
+    file.patch32(VersionOffset, Version);
+    file.patch32(SymbolCountOffset, symbols.size());
+
+    file.patch32(NamesOffset, file.size());
+    file.writeBytes(names.data());
+    file.patch32(DetailsOffset, file.size());
+    file.writeBytes(details.data());
+    file.align(8);
+    file.patch32(BitmapsOffset, file.size());
+    for (auto word : bitmaps) {
+        file.write64(word);
+    }
+    file.patch32(AritiesOffset, file.size());
+    file.writeBytes(arities.data());
+    file.patch32(KindsOffset, file.size());
+    file.writeBytes(kinds.data());
+    file.align(4);
+
+    file.patch32(TrigramsOffset, file.size());
+    file.patch32(TrigramEntriesOffset, trigram::write(nameList, file));
+    file.patch32(TrigramsSizeOffset, file.size() - read32(file.data().data(), TrigramsOffset));
+
+    file.patch32(StringsOffset, file.size());
+    file.patch32(StringsSizeOffset, strings.data().size());
+    file.writeBytes(strings.data());
+
+    return writeFileAtomically(Path, file.data());
+}
+
+std::unique_ptr<ResultStore> ResultStore::load(StringRef Path, std::string &ErrorMessage) {
+    auto buffer = MemoryBuffer::getFile(Path, -1, /*RequiresNullTerminator=*/false);
+    if (!buffer) {
+        ErrorMessage = ("cannot read " + Path + ": " + buffer.getError().message()).str();
+        return nullptr;
+    }
+
+    auto data = (*buffer)->getBuffer();
+    if (data.size() < HeaderSize || !data.startswith(StringRef(Magic, sizeof(Magic))) ||
+        read32(data.data(), VersionOffset) != Version) {
+        ErrorMessage = (Path + " is not a result store written by this version").str();
+        return nullptr;
+    }
+
+    uint64_t count = read32(data.data(), SymbolCountOffset);
+    uint64_t trigramsEnd = uint64_t(read32(data.data(), TrigramsOffset)) +
+                           read32(data.data(), TrigramsSizeOffset);
+    uint64_t stringsEnd = uint64_t(read32(data.data(), StringsOffset)) +
+                          read32(data.data(), StringsSizeOffset);
+    if (read32(data.data(), NamesOffset) + count * 4 > data.size() ||
+        read32(data.data(), DetailsOffset) + count * 4 > data.size() ||
+        read32(data.data(), BitmapsOffset) + BitmapCount * getBitmapWords(count) * 8 >
+            data.size() ||
+        read32(data.data(), AritiesOffset) + count > data.size() ||
+        read32(data.data(), KindsOffset) + count > data.size() ||
+        trigramsEnd > data.size() || stringsEnd > data.size()) {
+        ErrorMessage = (Path + " is truncated").str();
+        return nullptr;
+    }
+
+    return std::unique_ptr<ResultStore>(new ResultStore(std::move(*buffer)));
+}
+
+uint32_t ResultStore::header(uint32_t Offset) const {
+    return read32(Buffer->getBufferStart(), Offset);
+}
+
+StringRef ResultStore::string(uint32_t Offset) const {
+    return readString(StringRef(Buffer->getBufferStart() + header(StringsOffset),
+                                header(StringsSizeOffset)),
+                      Offset);
+}
+
+uint32_t ResultStore::size() const {
+    return header(SymbolCountOffset);
+}
+
+StringRef ResultStore::getName(uint32_t Symbol) const {
+    return string(read32(Buffer->getBufferStart(), header(NamesOffset) + Symbol * 4));
+}
+
+ResultStore::SymbolKind ResultStore::getKind(uint32_t Symbol) const {
+    return static_cast<SymbolKind>(Buffer->getBufferStart()[header(KindsOffset) + Symbol]);
+}
+
+StringRef ResultStore::getDetail(uint32_t Symbol) const {
+    return string(read32(Buffer->getBufferStart(), header(DetailsOffset) + Symbol * 4));
+}
+
+uint32_t ResultStore::getArity(uint32_t Symbol) const {
+    return static_cast<uint8_t>(Buffer->getBufferStart()[header(AritiesOffset) + Symbol]);
+}
+
+std::vector<uint32_t> ResultStore::findName(StringRef Pattern) const {
+    auto section = StringRef(Buffer->getBufferStart() + header(TrigramsOffset),
+                             header(TrigramsSizeOffset));
+    return trigram::search(section, header(TrigramEntriesOffset), size(), Pattern,
+                           [&](uint32_t Symbol) { return getName(Symbol); });
+}
+
+std::vector<uint32_t> ResultStore::find(const SymbolFilter &Filter) const {
+    const auto count = size();
+    const auto words = getBitmapWords(count);
+    const char *data = Buffer->getBufferStart();
+
+    std::vector<uint64_t> selected(words, ~uint64_t(0));
+    if (count % 64) {
+        selected.back() = (uint64_t(1) << (count % 64)) - 1;
+    }
+
+    auto intersect = [&](Bitmap Stored) {
+        auto offset = header(BitmapsOffset) + Stored * words * 8;
+        for (uint32_t word = 0; word < words; ++word) {
+            selected[word] &= read64(data, offset + word * 8);
+        }
+    };
+
+    if (Filter.OnlyConst) { intersect(ConstBitmap); }
+    if (Filter.Returns != SymbolFilter::AnyReturn) {
+        intersect(static_cast<Bitmap>(Filter.Returns));
+    }
+
+    if (Filter.MinParameters >= 0 || Filter.MaxParameters >= 0) {
+        const auto *arities = reinterpret_cast<const uint8_t *>(data + header(AritiesOffset));
+        const auto *kinds = reinterpret_cast<const uint8_t *>(data + header(KindsOffset));
+        const auto minimum = static_cast<unsigned>(std::max(Filter.MinParameters, 0));
+        const auto maximum = Filter.MaxParameters >= 0 ? static_cast<unsigned>(Filter.MaxParameters)
+                                                       : ~0u;
+        for (uint32_t word = 0; word < words; ++word) {
+            if (!selected[word]) { continue; }
+
+            uint64_t bits = 0;
+            const auto end = std::min(count - word * 64, 64u);
+            for (uint32_t bit = 0; bit < end; ++bit) {
+                const auto symbol = word * 64 + bit;
+                const bool match = kinds[symbol] == Method && arities[symbol] >= minimum &&
+                                   arities[symbol] <= maximum;
+                bits |= uint64_t(match) << bit;
+            }
+            selected[word] &= bits;
+        }
+    }
+
+    // Names are sorted, so a namespace is one contiguous range of symbols.
+    if (!Filter.Namespace.empty()) {
+        auto prefix = (Filter.Namespace + "::").str();
+        uint32_t first = 0;
+        uint32_t last = count;
+        while (first < last) {
+            auto middle = first + (last - first) / 2;
+            if (getName(middle) < prefix) { first = middle + 1; } else { last = middle; }
+        }
+        last = first;
+        while (last < count && getName(last).startswith(prefix)) { ++last; }
+
+        for (uint32_t word = 0; word < words; ++word) {
+            const uint64_t start = word * 64;
+            if (start + 64 <= first || start >= last) {
+                selected[word] = 0;
+                continue;
+            }
+            if (first > start) { selected[word] &= ~uint64_t(0) << (first - start); }
+            if (last < start + 64) { selected[word] &= ~(~uint64_t(0) << (last - start)); }
+        }
+    }
+
+    if (!Filter.Name.empty()) {
+        std::vector<uint64_t> named(words);
+        for (auto symbol : findName(Filter.Name)) {
+            named[symbol / 64] |= uint64_t(1) << (symbol % 64);
+        }
+        for (uint32_t word = 0; word < words; ++word) {
+            selected[word] &= named[word];
+        }
+    }
+
+    std::vector<uint32_t> found;
+    for (uint32_t word = 0; word < words; ++word) {
+        for (auto bits = selected[word]; bits; bits &= bits - 1) {
+            found.push_back(word * 64 + countTrailingZeros(bits));
+        }
+    }
+    return found;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "results/ScanResults.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// What a query selects; every set field must hold for a symbol to match.
+// Return, arity and constness only ever hold for methods.
+struct SymbolFilter {
+    enum ReturnCategory { AnyReturn, ReturnsVoid, ReturnsValue, ReturnsPointer, ReturnsReference };
+
+    llvm::StringRef Name;
+    llvm::StringRef Namespace;
+    ReturnCategory Returns = AnyReturn;
+    int MinParameters = -1;
+    int MaxParameters = -1;
+    bool OnlyConst = false;
+};
+
+// Scan results stored for querying without a rerun. Classes and methods are
+// symbols named by their qualified name, sorted by it, and every property
+// of a symbol is a column of its own so a query only reads what it tests.
+// Yes or no properties are bitmaps, so a filter combines them a word of 64
+// symbols at a time.
+//
+// Layout, little endian:
+//   header   magic "CTSTORE\0", version (u32), symbol count (u32), then the
+//            offsets of the name, detail, bitmap, arity and kind columns
+//            (u32 each), the trigram section's offset, entry count and size
+//            (u32 each) and the strings offset and size (u32 each)
+//   name     string offset (u32) per symbol
+//   detail   string offset (u32) per symbol: the file of a class, the
+//            signature of a method
+//   bitmaps  one bit per symbol, in u64 words, for each of: const method,
+//            returns void, returns a value, returns a pointer, returns a
+//            reference
+//   arity    parameter count (u8, 255 for 255 or more) per symbol
+//   kind     SymbolKind (u8) per symbol
+//   trigram  a trigram index over the names, see TrigramIndex.h
+//   strings  NUL terminated
+//
+// The return category is read off the spelling of the return type, so a
+// typedef of a pointer counts as a value.
+class ResultStore {
+    std::unique_ptr<llvm::MemoryBuffer> Buffer;
+
+    explicit ResultStore(std::unique_ptr<llvm::MemoryBuffer> Buffer)
+        : Buffer(std::move(Buffer)) {}
+
+    uint32_t header(uint32_t Offset) const;
+    llvm::StringRef string(uint32_t Offset) const;
+
+public:
+    enum SymbolKind : uint8_t { Class, Method };
+
+    static std::unique_ptr<ResultStore> load(llvm::StringRef Path, std::string &ErrorMessage);
+
+    uint32_t size() const;
+    llvm::StringRef getName(uint32_t Symbol) const;
+    SymbolKind getKind(uint32_t Symbol) const;
+    llvm::StringRef getDetail(uint32_t Symbol) const;
+    uint32_t getArity(uint32_t Symbol) const;
+
+    // Symbols whose qualified name contains Pattern, ignoring ASCII case.
+    std::vector<uint32_t> findName(llvm::StringRef Pattern) const;
+
+    // Symbols matching every field of Filter, in name order.
+    std::vector<uint32_t> find(const SymbolFilter &Filter) const;
+};
+
+// Classes seen in several results are stored once.
+std::error_code writeResultStore(llvm::StringRef Path, const ScanResults &Results);
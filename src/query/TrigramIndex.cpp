@@ -0,0 +1,199 @@
+#include "TrigramIndex.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define TRIGRAM_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace llvm;
+
+static char fold(char C) {
+    return C >= 'A' && C <= 'Z' ? static_cast<char>(C - 'A' + 'a') : C;
+}
+
+static uint32_t getTrigram(const char *Text) {
+    return uint32_t(uint8_t(fold(Text[0]))) << 16 | uint32_t(uint8_t(fold(Text[1]))) << 8 |
+           uint8_t(fold(Text[2]));
+}
+
+static bool containsFolded(StringRef Name, StringRef Pattern) {
+    if (Pattern.size() > Name.size()) { return false; }
+    for (size_t i = 0; i + Pattern.size() <= Name.size(); ++i) {
+        size_t j = 0;
+        while (j < Pattern.size() && fold(Name[i + j]) == fold(Pattern[j])) { ++j; }
+        if (j == Pattern.size()) { return true; }
+    }
+    return false;
+}
+
+namespace trigram {
+
+uint32_t write(ArrayRef<StringRef> Names, BinaryWriter &Out) {
+    DenseMap<uint32_t, std::vector<uint32_t>> postings;
+    for (uint32_t number = 0; number < Names.size(); ++number) {
+        const auto name = Names[number];
+        for (size_t i = 0; i + 3 <= name.size(); ++i) {
+            auto &list = postings[getTrigram(name.data() + i)];
+            // Numbers only grow, so a repeat within one name is the last entry.
+            if (list.empty() || list.back() != number) {
+                list.push_back(number);
+            }
+        }
+    }
+
+    std::vector<uint32_t> trigrams;
+    for (const auto &entry : postings) {
+        trigrams.push_back(entry.first);
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+
+    std::string encoded;
+    raw_string_ostream OS(encoded);
+    auto tableStart = Out.size();
+    auto postingsStart = static_cast<uint32_t>(trigrams.size()) * TableEntrySize;
+
+    for (auto key : trigrams) {
+        const auto &list = postings[key];
+        Out.write32(key);
+        Out.write32(list.size());
+        Out.write32(postingsStart + static_cast<uint32_t>(OS.tell()));
+
+        uint32_t previous = 0;
+        for (auto number : list) {
+            encodeULEB128(number - previous, OS);
+            previous = number;
+        }
+    }
+
+    assert(Out.size() - tableStart == postingsStart);
+    (void)tableStart;
+    Out.writeBytes(OS.str());
+    return trigrams.size();
+}
+
+size_t intersect(const uint32_t *A, size_t SizeA, const uint32_t *B, size_t SizeB, uint32_t *Out) {
+    size_t i = 0;
+    size_t j = 0;
+    size_t count = 0;
+
+#ifdef TRIGRAM_SSE2
+    // Compares a block of four from each list against all four rotations of
+    // the other, then drops whichever block ends first.
+    while (i + 4 <= SizeA && j + 4 <= SizeB) {
+        const auto maxA = A[i + 3];
+        const auto maxB = B[j + 3];
+
+        auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(A + i));
+        auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(B + j));
+        auto equal = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(a, b),
+                         _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))),
+                         _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3)))));
+
+        uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(equal));
+        while (mask) {
+            Out[count++] = A[i + countTrailingZeros(mask)];
+            mask &= mask - 1;
+        }
+
+        if (maxA <= maxB) { i += 4; }
+        if (maxB <= maxA) { j += 4; }
+    }
+#endif
+
+    while (i < SizeA && j < SizeB) {
+        if (A[i] < B[j]) {
+            ++i;
+        } else if (B[j] < A[i]) {
+            ++j;
+        } else {
+            Out[count++] = A[i];
+            ++i;
+            ++j;
+        }
+    }
+    return count;
+}
+
+std::vector<uint32_t> search(StringRef Section, uint32_t TableEntries, uint32_t NameCount,
+                             StringRef Pattern, function_ref<StringRef(uint32_t)> NameAt) {
+    std::vector<uint32_t> found;
+
+    // Too short to have a trigram, every name is a candidate.
+    if (Pattern.size() < 3) {
+        for (uint32_t number = 0; number < NameCount; ++number) {
+            if (containsFolded(NameAt(number), Pattern)) { found.push_back(number); }
+        }
+        return found;
+    }
+
+    std::vector<uint32_t> trigrams;
+    for (size_t i = 0; i + 3 <= Pattern.size(); ++i) {
+        trigrams.push_back(getTrigram(Pattern.data() + i));
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    // Table entries for each trigram, rarest first so the candidate list
+    // starts as small as it can.
+    std::vector<uint32_t> entries;
+    for (auto key : trigrams) {
+        uint32_t low = 0;
+        uint32_t high = TableEntries;
+        while (low < high) {
+            auto middle = low + (high - low) / 2;
+            if (read32(Section.data(), middle * TableEntrySize) < key) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        if (low == TableEntries || read32(Section.data(), low * TableEntrySize) != key) {
+            return found;
+        }
+        entries.push_back(low * TableEntrySize);
+    }
+    std::sort(entries.begin(), entries.end(), [&](uint32_t Left, uint32_t Right) {
+        return read32(Section.data(), Left + 4) < read32(Section.data(), Right + 4);
+    });
+
+    auto decode = [&](uint32_t Entry, std::vector<uint32_t> &Numbers) {
+        auto count = read32(Section.data(), Entry + 4);
+        auto *data = reinterpret_cast<const uint8_t *>(Section.data()) +
+                     read32(Section.data(), Entry + 8);
+        Numbers.resize(count);
+        uint32_t previous = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            unsigned size;
+            previous += static_cast<uint32_t>(decodeULEB128(data, &size));
+            data += size;
+            Numbers[i] = previous;
+        }
+    };
+
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> postings;
+    decode(entries.front(), candidates);
+    for (size_t i = 1; i < entries.size() && !candidates.empty(); ++i) {
+        decode(entries[i], postings);
+        candidates.resize(intersect(candidates.data(), candidates.size(), postings.data(),
+                                    postings.size(), candidates.data()));
+    }
+
+    for (auto number : candidates) {
+        if (containsFolded(NameAt(number), Pattern)) { found.push_back(number); }
+    }
+    return found;
+}
+
+}
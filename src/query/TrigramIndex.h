@@ -0,0 +1,39 @@
+#pragma once
+
+#include "support/BinaryFile.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <vector>
+
+// Case-insensitive substring search over a list of names. Every distinct
+// trigram of a name lists the names containing it, so a search reads the
+// postings of the pattern's trigrams, intersects them and only compares the
+// names that survive.
+//
+// Layout, little endian, relative to the start of the section:
+//   table     {trigram (u32), name count (u32), postings offset (u32)}
+//             sorted by trigram
+//   postings  name numbers in increasing order, each stored as the LEB128
+//             encoded difference from the previous one
+namespace trigram {
+
+constexpr uint32_t TableEntrySize = 12;
+
+// Writes the table and postings for Names and returns the number of table
+// entries. The postings start TableEntries * TableEntrySize bytes in.
+uint32_t write(llvm::ArrayRef<llvm::StringRef> Names, BinaryWriter &Out);
+
+// Numbers of the names containing Pattern, in increasing order. NameAt maps
+// a number back to its name for the final comparison.
+std::vector<uint32_t> search(llvm::StringRef Section, uint32_t TableEntries, uint32_t NameCount,
+                             llvm::StringRef Pattern,
+                             llvm::function_ref<llvm::StringRef(uint32_t)> NameAt);
+
+// Intersection of two strictly increasing lists, written to Out, which may
+// alias A. Returns the number of elements written.
+size_t intersect(const uint32_t *A, size_t SizeA, const uint32_t *B, size_t SizeB, uint32_t *Out);
+
+}
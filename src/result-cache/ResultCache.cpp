@@ -0,0 +1,394 @@
+#include "ResultCache.h"
+
+#include "support/BinaryFile.h"
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/MultiplexConsumer.h"
+#include "clang/Lex/HeaderSearch.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Lex/Preprocessor.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+static std::string getHash(ArrayRef<StringRef> Parts) {
+    MD5 hash;
+    for (auto part : Parts) {
+        hash.update(part);
+        // Keeps ("ab", "c") and ("a", "bc") apart.
+        hash.update(StringRef("", 1));
+    }
+    MD5::MD5Result result;
+    hash.final(result);
+
+    SmallString<32> key;
+    MD5::stringifyResult(result, key);
+    return key.str();
+}
+
+// Identifies the build of the tool, so that a new build never reads what an
+// older one stored whatever changed between them. Empty if the executable
+// cannot be read.
+static std::string getExecutableHash() {
+    auto path = sys::fs::getMainExecutable("", reinterpret_cast<void *>(&getExecutableHash));
+    auto buffer = MemoryBuffer::getFile(path, -1, /*RequiresNullTerminator=*/false);
+    if (path.empty() || !buffer) { return {}; }
+    return getHash({ (*buffer)->getBuffer() });
+}
+
+std::string getNormalizedPath(StringRef Path) {
+    SmallString<256> absolutePath(Path);
+    sys::fs::make_absolute(absolutePath);
+    sys::path::remove_dots(absolutePath, true);
+    return absolutePath.str();
+}
+
+ResultCache::ResultCache(StringRef Directory, uint64_t MaxSize, StringRef Configuration)
+    : Directory(Directory), MaxSize(MaxSize) {
+    auto executable = getExecutableHash();
+    Usable = !executable.empty();
+    this->Configuration = getHash({ executable, Configuration });
+    sys::fs::create_directories(Directory);
+}
+
+std::string ResultCache::getUnitKey(const CompileCommand &Command) const {
+    std::vector<StringRef> parts{ Configuration, Command.Directory, Command.Filename };
+    parts.insert(parts.end(), Command.CommandLine.begin(), Command.CommandLine.end());
+    return getHash(parts);
+}
+
+StringRef ResultCache::getContentHash(StringRef Path) {
+    auto &hash = ContentHashes[Path];
+    if (hash.empty()) {
+        auto buffer = MemoryBuffer::getFile(Path);
+        if (!buffer) { return {}; }
+        hash = getHash({ (*buffer)->getBuffer() });
+    }
+    return hash;
+}
+
+std::string ResultCache::getOutputPath(StringRef UnitKey, ArrayRef<std::string> Files) {
+    std::vector<StringRef> parts{ UnitKey };
+    for (const auto &file : Files) {
+        auto hash = getContentHash(file);
+        if (hash.empty()) { return {}; }
+        parts.push_back(file);
+        parts.push_back(hash);
+    }
+
+    SmallString<256> path(Directory);
+    sys::path::append(path, getHash(parts) + ".result");
+    return path.str();
+}
+
+// Files written by another user may refuse, they then age from when they
+// were written.
+static void touch(StringRef Path) {
+    int fd;
+    if (!sys::fs::openFileForRead(Path, fd)) {
+        sys::fs::setLastModificationAndAccessTime(
+            fd, std::chrono::time_point_cast<sys::TimePoint<>::duration>(
+                    std::chrono::system_clock::now()));
+        sys::Process::SafelyCloseFileDescriptor(fd);
+    }
+}
+
+bool ResultCache::lookup(StringRef UnitKey, std::string &Output) {
+    if (!Usable) { return false; }
+
+    SmallString<256> manifestPath(Directory);
+    sys::path::append(manifestPath, UnitKey + ".files");
+    auto manifest = MemoryBuffer::getFile(manifestPath);
+    if (!manifest) { return false; }
+
+    SmallVector<StringRef, 64> lines;
+    (*manifest)->getBuffer().split(lines, '\n', -1, false);
+    std::vector<std::string> files;
+    for (auto line : lines) {
+        if (line.consume_front("file\t")) {
+            files.push_back(line);
+        } else if (!line.consume_front("absent\t") || sys::fs::exists(line)) {
+            return false;
+        }
+    }
+
+    auto outputPath = getOutputPath(UnitKey, files);
+    if (outputPath.empty()) { return false; }
+
+    auto output = MemoryBuffer::getFile(outputPath);
+    if (!output) { return false; }
+    Output = (*output)->getBuffer();
+
+    // Marks the entry as used for eviction, the manifest too so that it does
+    // not age out from under its output.
+    touch(outputPath);
+    touch(manifestPath);
+    return true;
+}
+
+void ResultCache::store(StringRef UnitKey, const UnitInputs &Inputs, StringRef Output) {
+    if (!Usable) { return; }
+
+    auto outputPath = getOutputPath(UnitKey, Inputs.Files);
+    if (outputPath.empty()) { return; }
+
+    // The output goes first: a reader finding the manifest must find the
+    // output it leads to.
+    if (writeFileAtomically(outputPath, Output)) { return; }
+
+    SmallString<256> manifestPath(Directory);
+    sys::path::append(manifestPath, UnitKey + ".files");
+    writeStreamAtomically(manifestPath, [&](raw_ostream &OS) {
+        for (const auto &file : Inputs.Files) {
+            OS << "file\t" << file << "\n";
+        }
+        for (const auto &path : Inputs.Absent) {
+            OS << "absent\t" << path << "\n";
+        }
+    });
+    Stored = true;
+}
+
+void ResultCache::evict() {
+    if (!Stored) { return; }
+
+    struct Entry {
+        std::string Path;
+        uint64_t Size;
+        sys::TimePoint<> LastUsed;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (sys::fs::directory_iterator it(Directory, ec), end; it != end && !ec; it.increment(ec)) {
+        auto extension = sys::path::extension(it->path());
+        sys::fs::file_status status;
+        if ((extension != ".result" && extension != ".files") || sys::fs::status(it->path(), status)) {
+            continue;
+        }
+        entries.push_back({ it->path(), status.getSize(), status.getLastModificationTime() });
+        total += status.getSize();
+    }
+    if (total <= MaxSize) { return; }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &Left, const Entry &Right) {
+        return Left.LastUsed < Right.LastUsed;
+    });
+
+    // Another run may be evicting too, a file already gone still counts as
+    // freed.
+    for (const auto &entry : entries) {
+        if (total <= MaxSize) { break; }
+        sys::fs::remove(entry.Path);
+        total -= entry.Size;
+    }
+}
+
+namespace {
+
+// Lists every file the translation unit read once it has been parsed.
+class FileRecorder : public ASTConsumer {
+    SourceManager &Sources;
+    std::vector<std::string> &Files;
+
+public:
+    FileRecorder(SourceManager &Sources, std::vector<std::string> &Files)
+        : Sources(Sources), Files(Files) {}
+
+    void HandleTranslationUnit(ASTContext &Context) override {
+        for (auto it = Sources.fileinfo_begin(); it != Sources.fileinfo_end(); ++it) {
+            Files.push_back(getNormalizedPath(it->first->getName()));
+        }
+        std::sort(Files.begin(), Files.end());
+    }
+};
+
+// Reconstructs, for every header found through the include search path,
+// where the search looked before finding it. Those paths are absent now, and
+// a header created at one of them later would be included instead.
+class SearchRecorder : public PPCallbacks {
+    SourceManager &Sources;
+    HeaderSearch &Search;
+    StringSet<> &Absent;
+
+public:
+    SearchRecorder(SourceManager &Sources, HeaderSearch &Search, StringSet<> &Absent)
+        : Sources(Sources), Search(Search), Absent(Absent) {}
+
+    void InclusionDirective(SourceLocation HashLoc, const Token &IncludeTok, StringRef FileName,
+                            bool IsAngled, CharSourceRange FilenameRange, const FileEntry *File,
+                            StringRef SearchPath, StringRef RelativePath,
+                            const clang::Module *Imported) override {
+        // #include_next resumes after the includer's own directory, which is
+        // not known here. Absolute paths are not searched.
+        if (!File || sys::path::is_absolute(FileName) ||
+            IncludeTok.getIdentifierInfo()->getPPKeywordID() == tok::pp_include_next) {
+            return;
+        }
+
+        auto found = getNormalizedPath(File->getName());
+
+        // True once Directory is where the header was found.
+        auto probe = [&](StringRef Directory) {
+            if (Directory == SearchPath) { return true; }
+
+            SmallString<256> candidate(Directory);
+            sys::path::append(candidate, FileName);
+            auto path = getNormalizedPath(candidate);
+            if (path == found) { return true; }
+
+            Absent.insert(path);
+            return false;
+        };
+
+        // Quoted includes look next to the includer first.
+        if (!IsAngled) {
+            auto includer = Sources.getFileID(Sources.getExpansionLoc(HashLoc));
+            if (const auto *entry = Sources.getFileEntryForID(includer)) {
+                if (probe(entry->getDir()->getName())) { return; }
+            }
+        }
+
+        auto begin = IsAngled ? Search.angled_dir_begin() : Search.search_dir_begin();
+        for (auto it = begin; it != Search.search_dir_end(); ++it) {
+            // Header maps and frameworks are not directories to probe.
+            if (!it->isNormalDir()) { continue; }
+            if (probe(it->getDir()->getName())) { return; }
+        }
+    }
+};
+
+class CachingActionFactory;
+
+// Declared as the first base so that the analyses outlive the wrapped action
+// that refers to them.
+struct UnitRun {
+    std::vector<std::unique_ptr<Analysis>> Analyses;
+    std::unique_ptr<FrontendActionFactory> Factory;
+};
+
+class CachingAction : private UnitRun, public WrapperFrontendAction {
+    CachingActionFactory &Parent;
+    std::string File;
+    std::vector<std::string> Files;
+    StringSet<> Absent;
+
+protected:
+    std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
+                                                   StringRef InFile) override;
+    void EndSourceFileAction() override;
+
+public:
+    CachingAction(UnitRun Unit, CachingActionFactory &Parent)
+        : UnitRun(std::move(Unit)),
+          WrapperFrontendAction(std::unique_ptr<FrontendAction>(Factory->create())),
+          Parent(Parent) {}
+};
+
+class CachingActionFactory : public FrontendActionFactory {
+public:
+    ResultCache &Cache;
+    const StringMap<std::string> &UnitKeys;
+    std::function<std::vector<std::unique_ptr<Analysis>>()> CreateAnalyses;
+    TraversalScope Scope;
+    unsigned MatchJobs;
+    StringMap<std::string> &Outputs;
+
+    CachingActionFactory(ResultCache &Cache, const StringMap<std::string> &UnitKeys,
+                         std::function<std::vector<std::unique_ptr<Analysis>>()> CreateAnalyses,
+                         const TraversalScope &Scope, unsigned MatchJobs,
+                         StringMap<std::string> &Outputs)
+        : Cache(Cache), UnitKeys(UnitKeys), CreateAnalyses(std::move(CreateAnalyses)),
+          Scope(Scope), MatchJobs(MatchJobs), Outputs(Outputs) {}
+
+    FrontendAction *create() override {
+        UnitRun unit;
+        unit.Analyses = CreateAnalyses();
+        unit.Factory = newAnalysisActionFactory(unit.Analyses, Scope, MatchJobs);
+        return new CachingAction(std::move(unit), *this);
+    }
+};
+
+std::unique_ptr<ASTConsumer> CachingAction::CreateASTConsumer(CompilerInstance &CI,
+                                                              StringRef InFile) {
+    File = getNormalizedPath(InFile);
+
+    std::vector<std::unique_ptr<ASTConsumer>> consumers;
+    consumers.push_back(WrapperFrontendAction::CreateASTConsumer(CI, InFile));
+    if (!consumers.front()) { return nullptr; }
+    consumers.push_back(llvm::make_unique<FileRecorder>(CI.getSourceManager(), Files));
+
+    auto &preprocessor = CI.getPreprocessor();
+    preprocessor.addPPCallbacks(llvm::make_unique<SearchRecorder>(
+        CI.getSourceManager(), preprocessor.getHeaderSearchInfo(), Absent));
+    return llvm::make_unique<MultiplexConsumer>(std::move(consumers));
+}
+
+void CachingAction::EndSourceFileAction() {
+    WrapperFrontendAction::EndSourceFileAction();
+
+    // Each analysis' part is prefixed by its size, so that mergeUnitOutput
+    // can hand it back to the analysis it came from.
+    std::string output;
+    raw_string_ostream OS(output);
+    for (const auto &analysis : Analyses) {
+        std::string printed;
+        raw_string_ostream printedOS(printed);
+        analysis->print(printedOS);
+        OS << printedOS.str().size() << "\n" << printed;
+    }
+    OS.flush();
+    Parent.Outputs[File] += output;
+
+    // A unit that did not compile may have lost declarations.
+    auto key = Parent.UnitKeys.find(File);
+    if (key != Parent.UnitKeys.end() && !Files.empty() &&
+        !getCompilerInstance().getDiagnostics().hasErrorOccurred()) {
+        ResultCache::UnitInputs inputs;
+        inputs.Files = std::move(Files);
+        for (const auto &path : Absent) {
+            inputs.Absent.push_back(path.getKey());
+        }
+        std::sort(inputs.Absent.begin(), inputs.Absent.end());
+        Parent.Cache.store(key->second, inputs, output);
+    }
+}
+
+}
+
+std::unique_ptr<FrontendActionFactory> newCachingActionFactory(
+    ResultCache &Cache, const StringMap<std::string> &UnitKeys,
+    std::function<std::vector<std::unique_ptr<Analysis>>()> CreateAnalyses,
+    const TraversalScope &Scope, unsigned MatchJobs, StringMap<std::string> &Outputs) {
+    return llvm::make_unique<CachingActionFactory>(Cache, UnitKeys, std::move(CreateAnalyses),
+                                                   Scope, MatchJobs, Outputs);
+}
+
+void mergeUnitOutput(StringRef Output, ArrayRef<std::unique_ptr<Analysis>> Analyses) {
+    // A file compiled several ways holds one set of parts per way.
+    for (size_t part = 0; !Output.empty() && !Analyses.empty(); ++part) {
+        StringRef size;
+        std::tie(size, Output) = Output.split('\n');
+
+        size_t length;
+        if (size.getAsInteger(10, length) || length > Output.size()) { return; }
+
+        Analyses[part % Analyses.size()]->merge(Output.take_front(length));
+        Output = Output.drop_front(length);
+    }
+}
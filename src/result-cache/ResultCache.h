@@ -0,0 +1,85 @@
+#pragma once
+
+#include "analyses/Analysis.h"
+#include "scope/TraversalScope.h"
+
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Output of whole translation units kept in a directory that any number of
+// runs, users and CI jobs can share, so that an unchanged translation unit
+// is answered without starting clang.
+//
+// A unit is keyed by the tool's executable, the configuration (analyses,
+// queries, scope) and its compile command. That key names a manifest listing
+// the files the unit read last time and the paths its header search tried
+// without finding anything. The output is stored under the unit key combined
+// with the hashed contents of every one of those files, so editing any header
+// the unit includes is a miss, and so is creating a header where the search
+// looked first. Entries are written by atomic rename and read at any time,
+// and the least recently used ones are removed once the directory grows past
+// its size limit.
+class ResultCache {
+public:
+    // What a unit's output depends on besides its compile command.
+    struct UnitInputs {
+        // Every file the unit read, sorted.
+        std::vector<std::string> Files;
+        // Where the header search looked before the headers it found, sorted.
+        std::vector<std::string> Absent;
+    };
+
+private:
+    std::string Directory;
+    uint64_t MaxSize;
+    std::string Configuration;
+    // False when the executable cannot be identified, nothing is then read
+    // or stored.
+    bool Usable;
+    llvm::StringMap<std::string> ContentHashes;
+    bool Stored = false;
+
+    // Empty if Path cannot be read.
+    llvm::StringRef getContentHash(llvm::StringRef Path);
+    std::string getOutputPath(llvm::StringRef UnitKey, llvm::ArrayRef<std::string> Files);
+
+public:
+    // Configuration is anything besides the compile command that changes
+    // the output.
+    ResultCache(llvm::StringRef Directory, uint64_t MaxSize, llvm::StringRef Configuration);
+
+    std::string getUnitKey(const clang::tooling::CompileCommand &Command) const;
+
+    bool lookup(llvm::StringRef UnitKey, std::string &Output);
+    void store(llvm::StringRef UnitKey, const UnitInputs &Inputs, llvm::StringRef Output);
+
+    // Removes the least recently used entries until the directory fits its
+    // limit. Does nothing unless this run stored something.
+    void evict();
+};
+
+// Runs every translation unit with analyses of its own, made by
+// CreateAnalyses, so that its output stands alone. Outputs are collected by
+// absolute file name and those of files in UnitKeys are stored in Cache.
+// An output holds each analysis' part separately, see mergeUnitOutput.
+std::unique_ptr<clang::tooling::FrontendActionFactory> newCachingActionFactory(
+    ResultCache &Cache, const llvm::StringMap<std::string> &UnitKeys,
+    std::function<std::vector<std::unique_ptr<Analysis>>()> CreateAnalyses,
+    const TraversalScope &Scope, unsigned MatchJobs, llvm::StringMap<std::string> &Outputs);
+
+// Hands each of Analyses, made like the ones that ran, its part of a unit's
+// output. Merging every unit's output in order prints the same as a run
+// without the cache.
+void mergeUnitOutput(llvm::StringRef Output, llvm::ArrayRef<std::unique_ptr<Analysis>> Analyses);
+
+// Absolute and without dots, as the cache names files.
+std::string getNormalizedPath(llvm::StringRef Path);
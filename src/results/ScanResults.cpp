@@ -0,0 +1,55 @@
+#include "ScanResults.h"
+
+#include "llvm/ADT/SmallVector.h"
+
+void ScanResults::print(llvm::raw_ostream &OS) const {
+    for (const auto &record : Classes) {
+        OS << "class\t" << record.QualifiedName << "\t" << record.File << "\n";
+
+        for (const auto &method : record.Methods) {
+            OS << "method\t" << method.Name << "\t" << method.ReturnType << "\t"
+               << (method.IsConst ? "const" : "-");
+            for (const auto &parameter : method.ParameterTypes) {
+                OS << "\t" << parameter;
+            }
+            OS << "\n";
+        }
+    }
+}
+
+bool ScanResults::parse(llvm::StringRef Text) {
+    llvm::SmallVector<llvm::StringRef, 8> fields;
+
+    while (!Text.empty()) {
+        llvm::StringRef line;
+        std::tie(line, Text) = Text.split('\n');
+        if (line.empty()) { continue; }
+
+        fields.clear();
+        line.split(fields, '\t');
+
+        if (fields[0] == "class" && fields.size() == 3) {
+            ClassRecord record;
+            record.QualifiedName = fields[1];
+            record.File = fields[2];
+            Classes.push_back(std::move(record));
+            continue;
+        }
+
+        if (fields[0] == "method" && fields.size() >= 4 && !Classes.empty()) {
+            MethodRecord method;
+            method.Name = fields[1];
+            method.ReturnType = fields[2];
+            method.IsConst = fields[3] == "const";
+            for (size_t i = 4; i < fields.size(); ++i) {
+                method.ParameterTypes.push_back(fields[i]);
+            }
+            Classes.back().Methods.push_back(std::move(method));
+            continue;
+        }
+
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <vector>
+
+// A method signature with its types spelled as written in the source.
+struct MethodRecord {
+    std::string Name;
+    std::string ReturnType;
+    std::vector<std::string> ParameterTypes;
+    bool IsConst = false;
+};
+
+struct ClassRecord {
+    std::string QualifiedName;
+    std::string File;
+    std::vector<MethodRecord> Methods;
+};
+
+// Everything a scan found, printed one tab separated record per line:
+//   class   <qualified name>  <file>
+//   method  <name>  <return type>  <const|->  <parameter type>...
+// Method lines belong to the class line above them.
+struct ScanResults {
+    std::vector<ClassRecord> Classes;
+
+    void print(llvm::raw_ostream &OS) const;
+
+    // Reads records written by print(). Returns false on a malformed line.
+    bool parse(llvm::StringRef Text);
+};
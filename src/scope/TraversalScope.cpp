@@ -0,0 +1,252 @@
+#include "TraversalScope.h"
+
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Index/USRGeneration.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+#include <mutex>
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace llvm;
+
+// Name is Outer or a namespace nested in it.
+static bool isWithin(StringRef Name, StringRef Outer) {
+    return Name.startswith(Outer) &&
+           (Name.size() == Outer.size() || Name.substr(Outer.size()).startswith("::"));
+}
+
+static std::mutex SourceManagerMutex;
+
+namespace {
+
+class ScopedMatchVisitor : public RecursiveASTVisitor<ScopedMatchVisitor> {
+    typedef RecursiveASTVisitor<ScopedMatchVisitor> Base;
+
+    MatchFinder &Finder;
+    // MatchFinder::match sets up a fresh matching visitor for every node, and
+    // clang offers no way to keep one, so nodes of kinds that no matcher
+    // could match are not handed to it.
+    MatcherList::NodeKinds Kinds;
+    ASTContext &Context;
+    const TraversalScope &Scope;
+    // Whether declarations at the current namespace are in scope. Namespaces
+    // that only enclose an allowed one are walked without being matched.
+    bool InScope;
+    DenseMap<FileID, bool> FilesInScope;
+    const StringSet<> &SeenInstantiations;
+    StringSet<> &NewInstantiations;
+
+    enum class NamespaceScope { Inside, Enclosing, Outside };
+
+    // The namespace D belongs to, which for an out-of-line definition is not
+    // the one it is written in.
+    bool isSemanticallyInScope(const Decl &D) const {
+        const auto *ns =
+            dyn_cast<NamespaceDecl>(D.getDeclContext()->getEnclosingNamespaceContext());
+        return ns && classify(*ns) == NamespaceScope::Inside;
+    }
+
+    template <typename T> void match(const T &Node) {
+        if (InScope) { Finder.match(Node, Context); }
+    }
+
+    NamespaceScope classify(const NamespaceDecl &Namespace) const {
+        auto name = Namespace.getQualifiedNameAsString();
+        auto result = NamespaceScope::Outside;
+
+        for (const auto &allowed : Scope.Namespaces) {
+            if (isWithin(name, allowed)) { return NamespaceScope::Inside; }
+            if (isWithin(allowed, name)) { result = NamespaceScope::Enclosing; }
+        }
+        return result;
+    }
+
+    bool isFileInScope(const Decl &D) {
+        // SourceManager caches lookups without locking, and chunks of one
+        // translation unit may be matched on several threads.
+        std::lock_guard<std::mutex> lock(SourceManagerMutex);
+
+        auto &sourceManager = Context.getSourceManager();
+        auto location = sourceManager.getExpansionLoc(D.getLocation());
+        if (location.isInvalid()) { return true; }
+
+        auto file = sourceManager.getFileID(location);
+        auto found = FilesInScope.find(file);
+        if (found != FilesInScope.end()) { return found->second; }
+
+        auto inScope = true;
+        if (Scope.SkipSystemHeaders && sourceManager.isInSystemHeader(location)) {
+            inScope = false;
+        } else if (!Scope.Paths.empty()) {
+            const auto *entry = sourceManager.getFileEntryForID(file);
+            SmallString<256> path(entry ? entry->getName() : "");
+            sys::fs::make_absolute(path);
+            sys::path::remove_dots(path, true);
+
+            // A whole path component, /src/foo must not take in /src/foobar.
+            inScope = entry && llvm::any_of(Scope.Paths, [&](const std::string &Prefix) {
+                return path.startswith(Prefix) &&
+                       (path.size() == Prefix.size() || Prefix.empty() ||
+                        sys::path::is_separator(Prefix.back()) ||
+                        sys::path::is_separator(path[Prefix.size()]));
+            });
+        }
+
+        FilesInScope[file] = inScope;
+        return inScope;
+    }
+
+    // Implicit instantiations are traversed through TraverseDecl, so
+    // skipping one here skips its members and bodies too.
+    bool isRepeatedInstantiation(const Decl &D) {
+        TemplateSpecializationKind kind = TSK_Undeclared;
+        if (const auto *record = dyn_cast<ClassTemplateSpecializationDecl>(&D)) {
+            kind = record->getSpecializationKind();
+        } else if (const auto *function = dyn_cast<FunctionDecl>(&D)) {
+            kind = function->getTemplateSpecializationKind();
+        }
+        if (kind != TSK_ImplicitInstantiation) { return false; }
+
+        // The USR spells the canonical template arguments, and names the file
+        // of any that are local to one, such as types in an anonymous
+        // namespace, which their printed names would not tell apart.
+        SmallString<128> key;
+        if (index::generateUSRForDecl(&D, key)) {
+            // No USR, fall back to the printed name and type.
+            key.clear();
+            raw_svector_ostream OS(key);
+            cast<NamedDecl>(D).getNameForDiagnostic(OS, Context.getPrintingPolicy(), true);
+            if (const auto *function = dyn_cast<FunctionDecl>(&D)) {
+                OS << " " << function->getType().getCanonicalType().getAsString();
+            }
+        }
+
+        return SeenInstantiations.count(key) || !NewInstantiations.insert(key).second;
+    }
+
+public:
+    ScopedMatchVisitor(MatchFinder &Finder, const MatcherList &Matchers, ASTContext &Context,
+                       const TraversalScope &Scope, const StringSet<> &SeenInstantiations,
+                       StringSet<> &NewInstantiations)
+        : Finder(Finder), Kinds(Matchers.getNodeKinds()), Context(Context), Scope(Scope),
+          InScope(Scope.Namespaces.empty()),
+          SeenInstantiations(SeenInstantiations), NewInstantiations(NewInstantiations) {}
+
+    bool shouldVisitTemplateInstantiations() const {
+        return Scope.Instantiations != InstantiationPolicy::Primary;
+    }
+    bool shouldVisitImplicitCode() const { return true; }
+
+    bool TraverseDecl(Decl *D) {
+        if (!D || isa<TranslationUnitDecl>(D)) { return Base::TraverseDecl(D); }
+
+        if (Scope.Instantiations == InstantiationPolicy::Unique && isRepeatedInstantiation(*D)) {
+            return true;
+        }
+
+        // Only declarations at namespace scope are pruned, everything below
+        // an in-scope one is in scope.
+        if (!D->getLexicalDeclContext()->getRedeclContext()->isFileContext()) {
+            return Base::TraverseDecl(D);
+        }
+
+        if (!isFileInScope(*D)) { return true; }
+
+        auto savedInScope = InScope;
+        if (const auto *ns = dyn_cast<NamespaceDecl>(D)) {
+            if (!InScope && !Scope.Namespaces.empty()) {
+                auto namespaceScope = classify(*ns);
+                if (namespaceScope == NamespaceScope::Outside) { return true; }
+                InScope = namespaceScope == NamespaceScope::Inside;
+            }
+        } else if (!InScope && !isa<LinkageSpecDecl>(D)) {
+            if (Scope.Namespaces.empty() || !isSemanticallyInScope(*D)) { return true; }
+            InScope = true;
+        }
+
+        auto ret = Base::TraverseDecl(D);
+        InScope = savedInScope;
+        return ret;
+    }
+
+    bool VisitDecl(Decl *D) {
+        if (Kinds.Decls) { match(*D); }
+        return true;
+    }
+
+    bool VisitStmt(Stmt *S) {
+        if (Kinds.Stmts) { match(*S); }
+        return true;
+    }
+
+    // The rest mirror MatchFinder's traversal, which matches types and name
+    // specifiers on the way in rather than through Visit methods.
+    bool TraverseType(QualType T) {
+        if (Kinds.Types && !T.isNull()) { match(T); }
+        return Base::TraverseType(T);
+    }
+
+    bool TraverseTypeLoc(TypeLoc TL) {
+        if (!TL.isNull()) {
+            if (Kinds.TypeLocs) { match(TL); }
+            if (Kinds.Types) { match(TL.getType()); }
+        }
+        return Base::TraverseTypeLoc(TL);
+    }
+
+    bool TraverseNestedNameSpecifier(NestedNameSpecifier *NNS) {
+        if (Kinds.Specifiers && NNS) { match(*NNS); }
+        return Base::TraverseNestedNameSpecifier(NNS);
+    }
+
+    bool TraverseNestedNameSpecifierLoc(NestedNameSpecifierLoc NNS) {
+        if (!NNS) { return true; }
+        if (Kinds.SpecifierLocs) { match(NNS); }
+        if (Kinds.Specifiers && NNS.getNestedNameSpecifier()) {
+            match(*NNS.getNestedNameSpecifier());
+        }
+        return Base::TraverseNestedNameSpecifierLoc(NNS);
+    }
+};
+
+class ScopedMatchConsumer : public ASTConsumer {
+    MatchFinder &Finder;
+    const MatcherList &Matchers;
+    const TraversalScope &Scope;
+    StringSet<> &SeenInstantiations;
+
+public:
+    ScopedMatchConsumer(MatchFinder &Finder, const MatcherList &Matchers,
+                        const TraversalScope &Scope, StringSet<> &SeenInstantiations)
+        : Finder(Finder), Matchers(Matchers), Scope(Scope),
+          SeenInstantiations(SeenInstantiations) {}
+
+    void HandleTranslationUnit(ASTContext &Context) override {
+        matchInScope(Finder, Matchers, Context, Scope, Context.getTranslationUnitDecl(),
+                     SeenInstantiations, SeenInstantiations);
+    }
+};
+
+}
+
+void matchInScope(MatchFinder &Finder, const MatcherList &Matchers, ASTContext &Context,
+                  const TraversalScope &Scope, ArrayRef<Decl *> Decls,
+                  const StringSet<> &SeenInstantiations, StringSet<> &NewInstantiations) {
+    ScopedMatchVisitor visitor(Finder, Matchers, Context, Scope, SeenInstantiations,
+                               NewInstantiations);
+    for (auto *decl : Decls) {
+        visitor.TraverseDecl(decl);
+    }
+}
+
+std::unique_ptr<ASTConsumer> newScopedMatchConsumer(MatchFinder &Finder,
+                                                    const MatcherList &Matchers,
+                                                    const TraversalScope &Scope,
+                                                    StringSet<> &SeenInstantiations) {
+    return llvm::make_unique<ScopedMatchConsumer>(Finder, Matchers, Scope, SeenInstantiations);
+}
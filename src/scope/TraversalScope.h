@@ -0,0 +1,61 @@
+#pragma once
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "llvm/ADT/StringSet.h"
+
+#include "matchers/MatcherList.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Which implicit template instantiations are matched.
+enum class InstantiationPolicy {
+    // Every instantiation in every translation unit, MatchFinder's default.
+    All,
+    // Only the templates as written, no instantiations.
+    Primary,
+    // Each instantiation once per run, by its canonical template arguments.
+    Unique,
+};
+
+// The part of each translation unit worth matching. Declarations outside it
+// are pruned where they appear at namespace scope, so nothing beneath them
+// is traversed, let alone matched. A declaration written outside its
+// namespace, such as an out-of-line member definition, is judged by the
+// namespace it belongs to.
+//
+// Only matchers are scoped. Analyses with their own AST consumer see the
+// whole translation unit and cannot be combined with a scope.
+struct TraversalScope {
+    // Qualified namespaces such as Eegeo::Api. Nested namespaces are in
+    // scope; declarations outside all of them are not.
+    std::vector<std::string> Namespaces;
+    // Absolute directory or file prefixes a declaration must be spelled in.
+    std::vector<std::string> Paths;
+    bool SkipSystemHeaders = false;
+    InstantiationPolicy Instantiations = InstantiationPolicy::All;
+
+    bool empty() const {
+        return Namespaces.empty() && Paths.empty() && !SkipSystemHeaders &&
+               Instantiations == InstantiationPolicy::All;
+    }
+};
+
+// Runs Finder, which holds Matchers, on Decls and the in-scope part beneath
+// them, node by node the way MatchFinder's own traversal would. Under the
+// unique policy, instantiations in SeenInstantiations are skipped and new
+// ones are added to NewInstantiations, which may be the same set.
+void matchInScope(clang::ast_matchers::MatchFinder &Finder, const MatcherList &Matchers,
+                  clang::ASTContext &Context, const TraversalScope &Scope,
+                  llvm::ArrayRef<clang::Decl *> Decls,
+                  const llvm::StringSet<> &SeenInstantiations,
+                  llvm::StringSet<> &NewInstantiations);
+
+// Matches the in-scope part of each translation unit, in place of
+// Finder.newASTConsumer(). SeenInstantiations carries the unique policy's
+// state from one translation unit to the next.
+std::unique_ptr<clang::ASTConsumer>
+newScopedMatchConsumer(clang::ast_matchers::MatchFinder &Finder, const MatcherList &Matchers,
+                       const TraversalScope &Scope, llvm::StringSet<> &SeenInstantiations);
@@ -0,0 +1,68 @@
+#include "BinaryFile.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+void BinaryWriter::write32(uint32_t Value) {
+    char bytes[4];
+    support::endian::write32le(bytes, Value);
+    Buffer.append(bytes, bytes + sizeof(bytes));
+}
+
+void BinaryWriter::write64(uint64_t Value) {
+    char bytes[8];
+    support::endian::write64le(bytes, Value);
+    Buffer.append(bytes, bytes + sizeof(bytes));
+}
+
+void BinaryWriter::patch32(uint32_t Offset, uint32_t Value) {
+    assert(Offset + 4 <= Buffer.size() && "patching past the end");
+    support::endian::write32le(Buffer.data() + Offset, Value);
+}
+
+void BinaryWriter::align(uint32_t Alignment) {
+    while (Buffer.size() % Alignment) {
+        Buffer.push_back(0);
+    }
+}
+
+uint32_t StringPoolBuilder::add(StringRef Str) {
+    auto inserted = Offsets.insert({ Str, Pool.size() });
+    if (inserted.second) {
+        Pool.writeBytes(Str);
+        Pool.write8(0);
+    }
+    return inserted.first->second;
+}
+
+std::error_code writeFileAtomically(StringRef Path, StringRef Contents) {
+    return writeStreamAtomically(Path, [&](raw_ostream &OS) { OS << Contents; });
+}
+
+std::error_code writeStreamAtomically(StringRef Path, function_ref<void(raw_ostream &)> Write) {
+    int fd;
+    SmallString<128> tempPath;
+    if (auto ec = sys::fs::createUniqueFile(Path + ".tmp-%%%%%%%%", fd, tempPath)) {
+        return ec;
+    }
+
+    {
+        raw_fd_ostream OS(fd, /*shouldClose=*/true);
+        Write(OS);
+        OS.close();
+        if (OS.has_error()) {
+            OS.clear_error();
+            sys::fs::remove(tempPath);
+            return std::make_error_code(std::errc::io_error);
+        }
+    }
+
+    if (auto ec = sys::fs::rename(tempPath, Path)) {
+        sys::fs::remove(tempPath);
+        return ec;
+    }
+    return {};
+}
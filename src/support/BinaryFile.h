@@ -0,0 +1,70 @@
+#pragma once
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Endian.h"
+
+#include <cstdint>
+#include <system_error>
+
+namespace llvm {
+class raw_ostream;
+}
+
+// Helpers for the tool's on-disk caches and indexes. Every file is little
+// endian and addressed with offsets from the start of the file, so it
+// can be memory mapped and read in place without any parsing.
+
+// Appends fixed width little endian values to an in-memory image of a file.
+class BinaryWriter {
+    llvm::SmallVector<char, 0> Buffer;
+
+public:
+    uint32_t size() const { return static_cast<uint32_t>(Buffer.size()); }
+    llvm::StringRef data() const { return { Buffer.data(), Buffer.size() }; }
+
+    void write8(uint8_t Value) { Buffer.push_back(static_cast<char>(Value)); }
+    void write32(uint32_t Value);
+    void write64(uint64_t Value);
+    void writeBytes(llvm::StringRef Bytes) { Buffer.append(Bytes.begin(), Bytes.end()); }
+
+    // Overwrites a value written earlier, used for headers whose offsets are
+    // only known once the sections after them are written.
+    void patch32(uint32_t Offset, uint32_t Value);
+
+    // Pads with zeroes so the next section starts on a multiple of Alignment.
+    void align(uint32_t Alignment);
+};
+
+// Deduplicating pool of NUL terminated strings, referenced by their offset.
+class StringPoolBuilder {
+    llvm::StringMap<uint32_t> Offsets;
+    BinaryWriter Pool;
+
+public:
+    uint32_t add(llvm::StringRef Str);
+    llvm::StringRef data() const { return Pool.data(); }
+};
+
+inline uint32_t read32(const char *Data, uint32_t Offset) {
+    return llvm::support::endian::read32le(Data + Offset);
+}
+
+inline uint64_t read64(const char *Data, uint32_t Offset) {
+    return llvm::support::endian::read64le(Data + Offset);
+}
+
+// Reads a string out of a pool written by StringPoolBuilder.
+inline llvm::StringRef readString(llvm::StringRef Pool, uint32_t Offset) {
+    return Offset < Pool.size() ? llvm::StringRef(Pool.data() + Offset) : llvm::StringRef();
+}
+
+// Writes Contents to a uniquely named sibling of Path and renames it into
+// place, so concurrent readers only ever see a complete file.
+std::error_code writeFileAtomically(llvm::StringRef Path, llvm::StringRef Contents);
+
+// Same as above for files too large to build in memory first.
+std::error_code writeStreamAtomically(llvm::StringRef Path,
+                                      llvm::function_ref<void(llvm::raw_ostream &)> Write);
@@ -0,0 +1,51 @@
+#include "HeapTuning.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifdef __GLIBC__
+
+// glibc's largest mmap threshold on 64-bit hosts, larger blocks are always
+// mapped.
+constexpr size_t MaxMmapThreshold = 32 << 20;
+constexpr size_t TopPad = 64 << 20;
+constexpr size_t MinTrimThreshold = size_t(512) << 20;
+
+// Below the mmap threshold, so reserved blocks come from the heap.
+constexpr size_t ReserveBlockSize = 1 << 20;
+
+void tuneHeapForParsing(unsigned ReserveMegabytes) {
+    assert(ReserveMegabytes <= MaxHeapReserveMegabytes && "reserve above the trim threshold");
+    auto reserve = size_t(ReserveMegabytes) << 20;
+
+    mallopt(M_MMAP_THRESHOLD, MaxMmapThreshold);
+    mallopt(M_TOP_PAD, TopPad);
+    mallopt(M_TRIM_THRESHOLD,
+            static_cast<int>(std::max(MinTrimThreshold, reserve * 2)));
+
+    // Touching the blocks faults their pages in, freeing them leaves the
+    // pages with the heap since it is below the trim threshold.
+    std::vector<void *> blocks;
+    for (size_t reserved = 0; reserved < reserve; reserved += ReserveBlockSize) {
+        auto *block = std::malloc(ReserveBlockSize);
+        if (!block) { break; }
+        std::memset(block, 0, ReserveBlockSize);
+        blocks.push_back(block);
+    }
+    for (auto *block : blocks) {
+        std::free(block);
+    }
+}
+
+#else
+
+void tuneHeapForParsing(unsigned ReserveMegabytes) {}
+
+#endif
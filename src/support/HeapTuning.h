@@ -0,0 +1,19 @@
+#pragma once
+
+#include <climits>
+
+// Keeps memory freed by one translation unit in the process for the next.
+//
+// ASTContext, Sema and SourceManager allocate through malloc, so the heap
+// is where their slabs can be recycled: large blocks stay on the heap
+// instead of being mapped and unmapped per unit, freed memory is not
+// trimmed back to the kernel between units, and the heap grows in large
+// steps. ReserveMegabytes more are faulted in up front so that the first
+// units do not pay for page faults either.
+//
+// Only glibc is tuned; elsewhere this does nothing.
+void tuneHeapForParsing(unsigned ReserveMegabytes);
+
+// The trim threshold is an int and must stay above twice the reserve, or
+// the reserve would be trimmed straight back when it is freed.
+constexpr unsigned MaxHeapReserveMegabytes = (INT_MAX / 2) >> 20;
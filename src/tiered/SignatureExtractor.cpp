@@ -0,0 +1,498 @@
+#include "SignatureExtractor.h"
+
+#include "clang/Basic/LangOptions.h"
+#include "clang/Lex/Lexer.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace {
+
+struct RawToken {
+    tok::TokenKind Kind;
+    StringRef Text;
+};
+
+bool isBuiltinTypeName(StringRef Name) {
+    return StringSwitch<bool>(Name)
+        .Cases("void", "bool", "char", "int", "float", "double", true)
+        .Cases("wchar_t", "char16_t", "char32_t", true)
+        .Default(false);
+}
+
+// Words that either start something this tier does not handle, or would
+// need the type printer's canonical spelling (e.g. unsigned -> unsigned int).
+bool isUnsupportedKeyword(StringRef Name) {
+    return StringSwitch<bool>(Name)
+        .Cases("template", "typename", "operator", "friend", "union", true)
+        .Cases("unsigned", "signed", "short", "long", "auto", true)
+        .Cases("volatile", "extern", "decltype", "override", "final", true)
+        .Cases("noexcept", "throw", "alignas", "static_assert", "asm", true)
+        .Cases("__attribute__", "__declspec", "__cdecl", "__stdcall", true)
+        .Default(false);
+}
+
+class RawSignatureParser {
+    ArrayRef<RawToken> Tokens;
+    size_t Pos = 0;
+    StringRef File;
+    SmallVector<StringRef, 4> Namespaces;
+    std::vector<ClassRecord> &Classes;
+
+public:
+    RawSignatureParser(ArrayRef<RawToken> Tokens, StringRef File,
+                       std::vector<ClassRecord> &Classes)
+        : Tokens(Tokens), File(File), Classes(Classes) {}
+
+    bool parseFile() {
+        return parseDeclarations() && peek().Kind == tok::eof;
+    }
+
+private:
+    const RawToken &peek(size_t Ahead = 0) const {
+        return Tokens[std::min(Pos + Ahead, Tokens.size() - 1)];
+    }
+
+    bool isIdentifier(StringRef Text, size_t Ahead = 0) const {
+        return peek(Ahead).Kind == tok::raw_identifier && peek(Ahead).Text == Text;
+    }
+
+    bool consume(tok::TokenKind Kind) {
+        if (peek().Kind != Kind) { return false; }
+        ++Pos;
+        return true;
+    }
+
+    bool consumeIdentifier(StringRef Text) {
+        if (!isIdentifier(Text)) { return false; }
+        ++Pos;
+        return true;
+    }
+
+    // Skips a balanced {...}, starting on the opening brace.
+    bool skipBraces() {
+        unsigned depth = 0;
+        do {
+            switch (peek().Kind) {
+            case tok::l_brace: ++depth; break;
+            case tok::r_brace: --depth; break;
+            case tok::eof: return false;
+            default: break;
+            }
+            ++Pos;
+        } while (depth > 0);
+        return true;
+    }
+
+    // Skips to and past the ';' ending a declaration, or past the body of a
+    // function definition.
+    bool skipDeclaration() {
+        for (;;) {
+            switch (peek().Kind) {
+            case tok::semi: ++Pos; return true;
+            case tok::l_brace:
+                if (!skipBraces()) { return false; }
+                consume(tok::semi);
+                return true;
+            case tok::r_brace:
+            case tok::eof:
+                return false;
+            case tok::raw_identifier:
+                if (isUnsupportedKeyword(peek().Text) || isIdentifier("class") ||
+                    isIdentifier("struct") || isIdentifier("enum")) {
+                    return false;
+                }
+                LLVM_FALLTHROUGH;
+            default:
+                ++Pos;
+            }
+        }
+    }
+
+    std::string qualify(StringRef Name) const {
+        std::string qualified;
+        for (auto ns : Namespaces) {
+            qualified += ns;
+            qualified += "::";
+        }
+        return qualified + Name.str();
+    }
+
+    bool parseDeclarations() {
+        for (;;) {
+            const auto &token = peek();
+            if (token.Kind == tok::eof || token.Kind == tok::r_brace) { return true; }
+            if (consume(tok::semi)) { continue; }
+
+            if (token.Kind != tok::raw_identifier || isUnsupportedKeyword(token.Text)) {
+                return false;
+            }
+
+            if (consumeIdentifier("namespace")) {
+                if (peek().Kind != tok::raw_identifier || peek(1).Kind != tok::l_brace) {
+                    return false;
+                }
+                Namespaces.push_back(peek().Text);
+                Pos += 2;
+                if (!parseDeclarations() || !consume(tok::r_brace)) { return false; }
+                Namespaces.pop_back();
+                continue;
+            }
+
+            if (isIdentifier("class") || isIdentifier("struct")) {
+                if (!parseClass()) { return false; }
+                continue;
+            }
+
+            if (consumeIdentifier("enum")) {
+                while (peek().Kind != tok::l_brace && peek().Kind != tok::semi) {
+                    if (peek().Kind == tok::eof) { return false; }
+                    ++Pos;
+                }
+                if (peek().Kind == tok::l_brace && !skipBraces()) { return false; }
+                if (!consume(tok::semi)) { return false; }
+                continue;
+            }
+
+            // typedefs, using declarations, variables and free functions do
+            // not contribute records.
+            if (!skipDeclaration()) { return false; }
+        }
+    }
+
+    bool parseClass() {
+        ++Pos;
+        if (peek().Kind != tok::raw_identifier) { return false; }
+        auto name = peek().Text;
+        ++Pos;
+
+        // Forward declaration.
+        if (consume(tok::semi)) { return true; }
+
+        if (consume(tok::colon)) {
+            while (peek().Kind != tok::l_brace) {
+                if (peek().Kind == tok::eof || peek().Kind == tok::less ||
+                    peek().Kind == tok::semi) {
+                    return false;
+                }
+                ++Pos;
+            }
+        }
+        if (!consume(tok::l_brace)) { return false; }
+
+        ClassRecord record;
+        record.QualifiedName = qualify(name);
+        record.File = File;
+
+        while (!consume(tok::r_brace)) {
+            if (!parseMember(name, record)) { return false; }
+        }
+
+        Classes.push_back(std::move(record));
+        return consume(tok::semi);
+    }
+
+    bool parseMember(StringRef ClassName, ClassRecord &Record) {
+        if (consume(tok::semi)) { return true; }
+
+        if ((isIdentifier("public") || isIdentifier("protected") || isIdentifier("private")) &&
+            peek(1).Kind == tok::colon) {
+            Pos += 2;
+            return true;
+        }
+
+        if (consumeIdentifier("typedef") || consumeIdentifier("using")) {
+            return skipDeclaration();
+        }
+
+        while (consumeIdentifier("virtual") || consumeIdentifier("static") ||
+               consumeIdentifier("inline") || consumeIdentifier("explicit") ||
+               consumeIdentifier("constexpr") || consumeIdentifier("mutable")) {
+        }
+
+        if (consume(tok::tilde)) {
+            if (!consumeIdentifier(ClassName) || !consume(tok::l_paren) ||
+                !consume(tok::r_paren)) {
+                return false;
+            }
+            MethodRecord destructor;
+            destructor.Name = ("~" + ClassName).str();
+            destructor.ReturnType = "void";
+            Record.Methods.push_back(std::move(destructor));
+            return parseMethodEnd(nullptr);
+        }
+
+        // Constructors are not reported.
+        if (isIdentifier(ClassName) && peek(1).Kind == tok::l_paren) {
+            ++Pos;
+            std::vector<std::string> ignored;
+            return parseParameters(ignored) && parseMethodEnd(nullptr);
+        }
+
+        std::string type;
+        if (!parseType(type) || peek().Kind != tok::raw_identifier ||
+            isUnsupportedKeyword(peek().Text)) {
+            return false;
+        }
+        auto name = peek().Text;
+        ++Pos;
+
+        if (peek().Kind != tok::l_paren) {
+            // A data member.
+            return skipDeclaration();
+        }
+
+        MethodRecord method;
+        method.Name = name;
+        method.ReturnType = std::move(type);
+        if (!parseParameters(method.ParameterTypes) || !parseMethodEnd(&method.IsConst)) {
+            return false;
+        }
+        Record.Methods.push_back(std::move(method));
+        return true;
+    }
+
+    bool parseParameters(std::vector<std::string> &Types) {
+        if (!consume(tok::l_paren)) { return false; }
+        if (consume(tok::r_paren)) { return true; }
+
+        // (void) declares no parameters.
+        if (isIdentifier("void") && peek(1).Kind == tok::r_paren) {
+            Pos += 2;
+            return true;
+        }
+
+        for (;;) {
+            std::string type;
+            if (!parseType(type)) { return false; }
+
+            if (peek().Kind == tok::raw_identifier && !isUnsupportedKeyword(peek().Text)) {
+                ++Pos;
+            }
+            Types.push_back(std::move(type));
+
+            if (consume(tok::r_paren)) { return true; }
+            if (!consume(tok::comma)) { return false; }
+        }
+    }
+
+    // After the parameter list: an optional const and then ';' or a body.
+    bool parseMethodEnd(bool *IsConst) {
+        if (isIdentifier("const")) {
+            if (!IsConst) { return false; }
+            *IsConst = true;
+            ++Pos;
+        }
+        if (consume(tok::semi)) { return true; }
+        return peek().Kind == tok::l_brace && skipBraces();
+    }
+
+    // Accepts [const] name [const] *... [&|&&], the only shapes for which the
+    // spelling below is known to match clang's type printer.
+    bool parseType(std::string &Type) {
+        auto isConst = consumeIdentifier("const");
+
+        std::string base;
+        if (consume(tok::coloncolon)) { base = "::"; }
+        for (;;) {
+            if (peek().Kind != tok::raw_identifier || isUnsupportedKeyword(peek().Text) ||
+                isIdentifier("const") || isIdentifier("class") || isIdentifier("struct") ||
+                isIdentifier("enum")) {
+                return false;
+            }
+            auto name = peek().Text;
+            base += name;
+            ++Pos;
+
+            if (isBuiltinTypeName(name) || !consume(tok::coloncolon)) { break; }
+            base += "::";
+        }
+
+        if (consumeIdentifier("const")) {
+            if (isConst) { return false; }
+            isConst = true;
+        }
+
+        std::string declarator;
+        while (consume(tok::star)) {
+            declarator += "*";
+        }
+        if (consume(tok::amp)) {
+            declarator += "&";
+        } else if (consume(tok::ampamp)) {
+            declarator += "&&";
+        }
+
+        if (isIdentifier("const") || peek().Kind == tok::less || peek().Kind == tok::l_square ||
+            peek().Kind == tok::equal || peek().Kind == tok::ellipsis) {
+            return false;
+        }
+
+        Type = (isConst ? "const " : "") + base;
+        if (!declarator.empty()) {
+            Type += " " + declarator;
+        }
+        return true;
+    }
+};
+
+// Lexes the file and checks its directives. Only #pragma once and an include
+// guard are allowed, anything else could change what the tokens mean.
+bool lexFile(StringRef Buffer, std::vector<RawToken> &Tokens) {
+    LangOptions langOptions;
+    langOptions.CPlusPlus = 1;
+    langOptions.CPlusPlus11 = 1;
+    langOptions.Bool = 1;
+
+    Lexer lexer(SourceLocation(), langOptions, Buffer.begin(), Buffer.begin(), Buffer.end());
+
+    struct LexedToken {
+        RawToken Token;
+        bool AtStartOfLine;
+    };
+
+    std::vector<LexedToken> lexed;
+    Token token;
+    do {
+        lexer.LexFromRawLexer(token);
+        auto text = token.is(tok::raw_identifier) ? token.getRawIdentifier() : StringRef();
+        lexed.push_back({ { token.getKind(), text }, token.isAtStartOfLine() });
+    } while (token.isNot(tok::eof));
+
+    StringRef guard;
+    auto guardDefined = false;
+    auto guardClosed = false;
+
+    for (size_t i = 0; i < lexed.size(); ++i) {
+        const auto &current = lexed[i];
+        if (current.Token.Kind == tok::eof) { break; }
+
+        if (current.Token.Kind != tok::hash || !current.AtStartOfLine) {
+            if (guardClosed) { return false; }
+            Tokens.push_back(current.Token);
+            continue;
+        }
+
+        SmallVector<StringRef, 4> directive;
+        while (i + 1 < lexed.size() && !lexed[i + 1].AtStartOfLine &&
+               lexed[i + 1].Token.Kind != tok::eof) {
+            if (lexed[++i].Token.Kind != tok::raw_identifier) { return false; }
+            directive.push_back(lexed[i].Token.Text);
+        }
+
+        if (guardClosed) { return false; }
+
+        if (directive.size() == 2 && directive[0] == "pragma" && directive[1] == "once") {
+            continue;
+        }
+        if (directive.size() == 2 && directive[0] == "ifndef" && guard.empty() &&
+            Tokens.empty()) {
+            guard = directive[1];
+            continue;
+        }
+        if (directive.size() == 2 && directive[0] == "define" && !guard.empty() &&
+            !guardDefined && directive[1] == guard) {
+            guardDefined = true;
+            continue;
+        }
+        if (directive.size() == 1 && directive[0] == "endif" && guardDefined) {
+            guardClosed = true;
+            continue;
+        }
+        return false;
+    }
+
+    if (!guard.empty() && !guardClosed) { return false; }
+
+    Tokens.push_back({ tok::eof, StringRef() });
+    return true;
+}
+
+// Names the command line may have turned into macros.
+void collectDefinedNames(const CompileCommand &Command, StringSet<> &Names, bool &HasForcedInclude) {
+    const auto &args = Command.CommandLine;
+    for (size_t i = 0; i < args.size(); ++i) {
+        StringRef arg = args[i];
+        if (arg == "-include" || arg == "-imacros") {
+            HasForcedInclude = true;
+            continue;
+        }
+        if (!arg.consume_front("-D")) { continue; }
+        if (arg.empty() && i + 1 < args.size()) {
+            arg = args[++i];
+        }
+        Names.insert(arg.split('=').first.split('(').first);
+    }
+}
+
+// The lexer above assumes C++. Anything clang would read as C or
+// Objective-C goes to clang instead.
+bool isCPlusPlusCommand(const CompileCommand &Command) {
+    auto explicitLanguage = false;
+    const auto &args = Command.CommandLine;
+    for (size_t i = 0; i < args.size(); ++i) {
+        StringRef arg = args[i];
+        if (arg == "-ObjC" || arg == "-ObjC++") { return false; }
+
+        if (arg.consume_front("-x")) {
+            if (arg.empty() && i + 1 < args.size()) {
+                arg = args[++i];
+            }
+            if (arg != "c++" && arg != "c++-header") { return false; }
+            explicitLanguage = true;
+            continue;
+        }
+
+        if (arg.consume_front("-std=") &&
+            !(arg.startswith("c++") || arg.startswith("gnu++"))) {
+            return false;
+        }
+    }
+    if (explicitLanguage) { return true; }
+
+    // Without -x clang goes by the extension, .h is a C header to it.
+    return StringSwitch<bool>(sys::path::extension(Command.Filename))
+        .Cases(".c", ".h", ".i", ".m", ".mm", ".mi", ".mii", false)
+        .Default(true);
+}
+
+} // namespace
+
+bool extractSignatures(StringRef Path, const CompileCommand &Command, ScanResults &Results) {
+    if (!isCPlusPlusCommand(Command)) { return false; }
+
+    StringSet<> definedNames;
+    auto hasForcedInclude = false;
+    collectDefinedNames(Command, definedNames, hasForcedInclude);
+    if (hasForcedInclude) { return false; }
+
+    auto buffer = MemoryBuffer::getFile(Path);
+    if (!buffer) { return false; }
+
+    std::vector<RawToken> tokens;
+    if (!lexFile((*buffer)->getBuffer(), tokens)) { return false; }
+
+    for (const auto &token : tokens) {
+        if (token.Kind == tok::raw_identifier &&
+            (token.Text.startswith("__") || definedNames.count(token.Text))) {
+            return false;
+        }
+    }
+
+    std::vector<ClassRecord> classes;
+    // Name the file the way clang's SourceManager does, as the command spells
+    // it, so output does not depend on which tier handled the unit.
+    RawSignatureParser parser(tokens, Command.Filename, classes);
+    if (!parser.parseFile()) { return false; }
+
+    Results.Classes.insert(Results.Classes.end(), std::make_move_iterator(classes.begin()),
+                           std::make_move_iterator(classes.end()));
+    return true;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "results/ScanResults.h"
+
+#include "clang/Tooling/CompilationDatabase.h"
+
+// Tier-1 signature extraction. Recognises namespaces, class definitions and
+// plain method declarations straight from raw tokens, with no preprocessing
+// or semantic analysis, and spells types the way the clang path prints them.
+//
+// Returns false, leaving Results untouched, as soon as the file holds
+// anything it cannot classify with certainty: macros or directives other
+// than an include guard, templates, nested types, operators, default
+// arguments, identifiers defined on the command line and the like. C and
+// Objective-C inputs are never handled. Such files need the full clang
+// parse.
+bool extractSignatures(llvm::StringRef Path, const clang::tooling::CompileCommand &Command,
+                       ScanResults &Results);
@@ -0,0 +1,168 @@
+#include "VfsPack.h"
+
+#include "arguments/AnalysisArguments.h"
+#include "file-cache/SharedFileCache.h"
+#include "support/BinaryFile.h"
+
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/Tooling.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+static cl::OptionCategory PackCategory("pack options");
+
+static cl::opt<std::string> PackOutput(
+    "pack-output", cl::desc("Archive to write the dependency closure to"),
+    cl::value_desc("file"), cl::cat(PackCategory));
+
+namespace {
+
+constexpr char Magic[] = { 'C', 'T', 'P', 'A', 'C', 'K', 0, 0 };
+constexpr uint32_t Version = 1;
+
+enum : uint32_t {
+    VersionOffset = 8,
+    FileCountOffset = 12,
+    IndexOffset = 16,
+    StringsOffset = 20,
+    StringsSizeOffset = 24,
+    HeaderSize = 28
+};
+
+constexpr uint32_t EntrySize = 24;
+
+} // namespace
+
+std::unique_ptr<VfsPack> VfsPack::load(StringRef Path, std::string &ErrorMessage) {
+    // Read rather than map, the whole archive is needed and a sequential
+    // read is what slow and network file systems handle best.
+    auto buffer = MemoryBuffer::getFile(Path, -1, /*RequiresNullTerminator=*/false,
+                                        /*IsVolatileSize=*/true);
+    if (!buffer) {
+        ErrorMessage = ("cannot read " + Path + ": " + buffer.getError().message()).str();
+        return nullptr;
+    }
+
+    auto data = (*buffer)->getBuffer();
+    if (data.size() < HeaderSize || !data.startswith(StringRef(Magic, sizeof(Magic))) ||
+        read32(data.data(), VersionOffset) != Version) {
+        ErrorMessage = (Path + " is not a pack written by this version").str();
+        return nullptr;
+    }
+
+    uint64_t indexEnd = read32(data.data(), IndexOffset) +
+                        uint64_t(read32(data.data(), FileCountOffset)) * EntrySize;
+    uint64_t stringsEnd = uint64_t(read32(data.data(), StringsOffset)) +
+                          read32(data.data(), StringsSizeOffset);
+    if (indexEnd > data.size() || stringsEnd > data.size()) {
+        ErrorMessage = (Path + " is truncated").str();
+        return nullptr;
+    }
+
+    // Names are read as C strings, the pool must end in a NUL. Entries are
+    // checked as they are mapped.
+    if (read32(data.data(), StringsSizeOffset) && data[stringsEnd - 1] != 0) {
+        ErrorMessage = (Path + " is corrupt").str();
+        return nullptr;
+    }
+
+    return std::unique_ptr<VfsPack>(new VfsPack(std::move(*buffer)));
+}
+
+uint32_t VfsPack::size() const {
+    return read32(Buffer->getBufferStart(), FileCountOffset);
+}
+
+void VfsPack::mapInto(ClangTool &Tool) const {
+    auto *data = Buffer->getBufferStart();
+    auto strings = StringRef(data + read32(data, StringsOffset), read32(data, StringsSizeOffset));
+    auto index = read32(data, IndexOffset);
+
+    for (uint32_t i = 0, e = size(); i < e; ++i) {
+        auto entry = index + i * EntrySize;
+        auto name = read32(data, entry);
+        auto offset = read64(data, entry + 8);
+        auto size = read64(data, entry + 16);
+
+        // Contents are followed by the NUL mapVirtualFile's buffer expects.
+        // Compared without adding, which could wrap.
+        auto bufferSize = Buffer->getBufferSize();
+        if (name >= strings.size() || offset >= bufferSize || size >= bufferSize - offset ||
+            data[offset + size] != 0) {
+            continue;
+        }
+
+        Tool.mapVirtualFile(readString(strings, name), StringRef(data + offset, size));
+    }
+}
+
+static std::error_code writePack(StringRef Path) {
+    std::vector<std::pair<StringRef, StringRef>> files;
+    SharedFileCache::instance().forEachFile([&](StringRef Name, StringRef Contents) {
+        files.emplace_back(Name, Contents);
+    });
+    std::sort(files.begin(), files.end());
+
+    StringPoolBuilder strings;
+    std::vector<uint32_t> names;
+    for (const auto &file : files) {
+        names.push_back(strings.add(file.first));
+    }
+
+    BinaryWriter header;
+    header.writeBytes(StringRef(Magic, sizeof(Magic)));
+    header.write32(Version);
+    header.write32(files.size());
+    header.write32(HeaderSize);
+    header.write32(HeaderSize + files.size() * EntrySize);
+    header.write32(strings.data().size());
+
+    uint64_t offset = header.size() + files.size() * EntrySize + strings.data().size();
+    for (size_t i = 0; i < files.size(); ++i) {
+        header.write32(names[i]);
+        header.write32(0);
+        header.write64(offset);
+        header.write64(files[i].second.size());
+        offset += files[i].second.size() + 1;
+    }
+
+    return writeStreamAtomically(Path, [&](raw_ostream &OS) {
+        OS << header.data() << strings.data();
+        for (const auto &file : files) {
+            OS << file.second << '\0';
+        }
+    });
+}
+
+int runPackCommand(int argc, const char **argv) {
+    CommonOptionsParser OptionsParser(argc, argv, PackCategory);
+
+    if (PackOutput.empty()) {
+        errs() << "error: pack requires --pack-output=<file>\n";
+        return 1;
+    }
+
+    // Same adjusted commands as the scans that will read the pack.
+    AnalysisCompilationDatabase compilations(OptionsParser.getCompilations());
+    ClangTool Tool(compilations, OptionsParser.getSourcePathList());
+
+    // The pack is whatever passes through the shared cache.
+    Tool.getFiles().addStatCache(llvm::make_unique<SharedStatCache>());
+
+    auto ret = Tool.run(newFrontendActionFactory<PreprocessOnlyAction>().get());
+
+    if (auto ec = writePack(PackOutput)) {
+        errs() << "error: cannot write " << PackOutput << ": " << ec.message() << "\n";
+        return 1;
+    }
+
+    return ret;
+}
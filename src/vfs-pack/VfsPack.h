@@ -0,0 +1,44 @@
+#pragma once
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <memory>
+#include <string>
+
+namespace clang {
+namespace tooling {
+class ClangTool;
+}
+}
+
+// A snapshot of every file a set of translation units reads, stored in one
+// archive so a scan can load it with a single sequential read.
+//
+// Layout, little endian:
+//   header  magic "CTPACK\0\0", version (u32), file count (u32), index
+//           offset (u32), strings offset (u32), strings size (u32)
+//   index   {path (u32), padding (u32), data offset (u64), size (u64)}
+//           sorted by absolute path
+//   strings NUL terminated paths
+//   data    file contents, each followed by a NUL byte so it can be handed
+//           to clang without a copy
+class VfsPack {
+    std::unique_ptr<llvm::MemoryBuffer> Buffer;
+
+    explicit VfsPack(std::unique_ptr<llvm::MemoryBuffer> Buffer)
+        : Buffer(std::move(Buffer)) {}
+
+public:
+    static std::unique_ptr<VfsPack> load(llvm::StringRef Path, std::string &ErrorMessage);
+
+    // Serves every file in the pack from ClangTool's in-memory file system
+    // overlay. The pack must outlive the tool run.
+    void mapInto(clang::tooling::ClangTool &Tool) const;
+
+    uint32_t size() const;
+};
+
+// The "pack" subcommand: preprocesses the given sources and writes every
+// file they read to the archive named by --pack-output.
+int runPackCommand(int argc, const char **argv);